@@ -0,0 +1,167 @@
+#ifdef OPTIMIZER_ALLOCATION_PROFILING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "allocation_profiling.h"
+
+#define MAXIMUM_ALLOCATION_TAGS 64
+// every block starts with its size and tag, 16 bytes keep the payload aligned like malloc's
+#define ALLOCATION_HEADER_SIZE 16
+
+struct allocation_header {
+    size_t size;
+    int tag;
+};
+
+struct allocation_tag_counts {
+    const char *tag_name; // tag 0, the allocations made outside every pass, has none
+    std::atomic<unsigned long long> allocations;
+    std::atomic<unsigned long long> bytes;
+    std::atomic<long long> live_bytes;
+    std::atomic<long long> peak_live_bytes;
+};
+
+// all of these are constant initialized, operator new may run before any constructor does
+static allocation_tag_counts tag_counts[MAXIMUM_ALLOCATION_TAGS];
+static std::atomic<int> number_of_tags(1);
+static std::mutex tag_registration_lock;
+static std::atomic<long long> total_live_bytes(0);
+static std::atomic<long long> peak_total_live_bytes(0);
+static thread_local int current_tag = 0;
+
+static void record_maximum(std::atomic<long long> &maximum, long long candidate) {
+    long long current = maximum.load(std::memory_order_relaxed);
+    while (candidate > current && !maximum.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+    }
+}
+
+// tag names are string literals, so the pointer is compared first
+static int find_tag(const char *tag_name) {
+    int known_tags = number_of_tags.load(std::memory_order_acquire);
+    for (int tag = 1; tag < known_tags; tag++) {
+        if (tag_counts[tag].tag_name == tag_name || strcmp(tag_counts[tag].tag_name, tag_name) == 0) {
+            return tag;
+        }
+    }
+    std::lock_guard<std::mutex> guard(tag_registration_lock);
+    known_tags = number_of_tags.load(std::memory_order_relaxed);
+    for (int tag = 1; tag < known_tags; tag++) {
+        if (strcmp(tag_counts[tag].tag_name, tag_name) == 0) {
+            return tag;
+        }
+    }
+    if (known_tags == MAXIMUM_ALLOCATION_TAGS) {
+        return 0;
+    }
+    tag_counts[known_tags].tag_name = tag_name;
+    number_of_tags.store(known_tags + 1, std::memory_order_release);
+    return known_tags;
+}
+
+scoped_allocation_tag::scoped_allocation_tag(const char *tag_name) : previous_tag(current_tag) {
+    current_tag = find_tag(tag_name);
+}
+
+scoped_allocation_tag::~scoped_allocation_tag() {
+    current_tag = previous_tag;
+}
+
+static void *profiled_allocate(size_t size) {
+    char *block = (char *) malloc(size + ALLOCATION_HEADER_SIZE);
+    if (block == NULL) {
+        return NULL;
+    }
+    allocation_header *header = (allocation_header *) block;
+    header->size = size;
+    header->tag = current_tag;
+    allocation_tag_counts &counts = tag_counts[header->tag];
+    counts.allocations.fetch_add(1, std::memory_order_relaxed);
+    counts.bytes.fetch_add(size, std::memory_order_relaxed);
+    record_maximum(counts.peak_live_bytes, counts.live_bytes.fetch_add(size, std::memory_order_relaxed) + (long long) size);
+    record_maximum(peak_total_live_bytes, total_live_bytes.fetch_add(size, std::memory_order_relaxed) + (long long) size);
+    return block + ALLOCATION_HEADER_SIZE;
+}
+
+static void profiled_free(void *pointer) {
+    if (pointer == NULL) {
+        return;
+    }
+    char *block = (char *) pointer - ALLOCATION_HEADER_SIZE;
+    allocation_header *header = (allocation_header *) block;
+    tag_counts[header->tag].live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    total_live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    free(block);
+}
+
+void *operator new(size_t size) {
+    void *pointer = profiled_allocate(size);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return profiled_allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return profiled_allocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    profiled_free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    profiled_free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    profiled_free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    profiled_free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    profiled_free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    profiled_free(pointer);
+}
+
+void print_allocation_report(FILE *output) {
+    std::vector<int> tags;
+    for (int tag = 0; tag < number_of_tags.load(std::memory_order_acquire); tag++) {
+        if (tag_counts[tag].allocations.load(std::memory_order_relaxed) != 0) {
+            tags.push_back(tag);
+        }
+    }
+    std::sort(tags.begin(), tags.end(), [](int a, int b) { return tag_counts[a].bytes.load() > tag_counts[b].bytes.load(); });
+
+    fprintf(output, "===== Allocations per pass (operator new, exclusive of nested passes) =====\n");
+    fprintf(output, "  %12s %14s %10s %14s  %s\n", "allocations", "bytes", "bytes/alloc", "peak live", "pass");
+    for (int tag : tags) {
+        allocation_tag_counts &counts = tag_counts[tag];
+        unsigned long long allocations = counts.allocations.load(std::memory_order_relaxed);
+        unsigned long long bytes = counts.bytes.load(std::memory_order_relaxed);
+        fprintf(output, "  %12llu %14llu %10.1f %14lld  %s\n", allocations, bytes, (double) bytes / allocations,
+                counts.peak_live_bytes.load(std::memory_order_relaxed), tag == 0 ? "(outside the passes)" : counts.tag_name);
+    }
+    fprintf(output, "peak live bytes of the whole process: %lld\n", peak_total_live_bytes.load(std::memory_order_relaxed));
+}
+
+#endif
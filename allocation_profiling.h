@@ -0,0 +1,29 @@
+#ifndef ALLOCATION_PROFILING_H
+#define ALLOCATION_PROFILING_H
+
+#include <stdio.h>
+
+// Allocation profiling build mode, compiled in with -DOPTIMIZER_ALLOCATION_PROFILING
+//
+// The global operator new and delete are replaced to count the allocations, the bytes and the
+// live bytes of every pass. Each scoped_pass_timer also opens an allocation tag named after its
+// pass, so an allocation is charged to the innermost pass running on the thread (the sets that
+// in_and_out_sets_map copies count for it, not for constant_propagation_and_constant_folding)
+// and a delete gives the bytes back to the pass that allocated them. Allocations LLVM makes on
+// behalf of a pass are counted too. Without the flag none of this is compiled.
+
+#ifdef OPTIMIZER_ALLOCATION_PROFILING
+
+struct scoped_allocation_tag {
+    int previous_tag;
+
+    explicit scoped_allocation_tag(const char *tag_name);
+    ~scoped_allocation_tag();
+};
+
+// allocations, bytes and peak live bytes of every tag, most bytes first
+void print_allocation_report(FILE *output);
+
+#endif
+
+#endif
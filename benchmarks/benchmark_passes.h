@@ -0,0 +1,19 @@
+#ifndef BENCHMARK_PASSES_H
+#define BENCHMARK_PASSES_H
+
+// the pass timers the benchmarks report, named after the functions implementing the passes
+static const char *timed_passes[] = {
+    "optimize_function",
+    "run_common_subexpression_elimination",
+    "run_constant_folding",
+    "run_dead_code_elimination",
+    "constant_propagation_and_constant_folding",
+    "taking_load_into_consideration",
+    "in_and_out_sets_map",
+    "compute_kill_set_for_block",
+    "compute_gen_set_for_block",
+    "build_function_snapshot",
+};
+#define NUMBER_OF_TIMED_PASSES (sizeof(timed_passes) / sizeof(timed_passes[0]))
+
+#endif
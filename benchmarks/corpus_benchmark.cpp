@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "../optimizer.h"
+#include "../inliner.h"
+#include "../function_specialization.h"
+#include "../pass_timing.h"
+#include "benchmark_passes.h"
+
+// Runs the optimizer over the optimizer_tests corpus, checks the outputs and compares the
+// per pass timings and the peak memory with a checked-in baseline
+//
+// ./corpus_benchmark [--corpus optimizer_tests] [--iterations N] [--baseline benchmarks/corpus_baseline.txt]
+//                    [--threshold-percent N] [--write-baseline]
+//
+// Output check: for every X.ll with an X_opt.ll next to it, optimizing X.ll must give the same
+// module as optimizing X_opt.ll. The expected files are what the passes had to reach at least
+// (the current passes go further, e.g. they remove the dead allocas), so the check accepts any
+// result the expected output also converges to. A file whose first line is
+// "; ./optimizer_executable <flags> ..." is optimized with those flags, as the executable would.
+//
+// exit code: 0 ok, 1 usage, 2 output mismatch, 3 median time or peak memory regression
+
+#define DEFAULT_ITERATIONS 200
+#define DEFAULT_THRESHOLD_PERCENT 25.0
+// a regression also has to be larger than this, differences below it are timer noise
+#define MINIMUM_TIME_REGRESSION_MS 0.1
+// the tail is noisier than the median, so p99 gets this many times the threshold and the minimum
+// and a p99 regression alone is only reported as a warning
+#define P99_TOLERANCE_FACTOR 2
+
+struct pass_samples {
+    std::vector<double> samples_ms;
+    double median_ms;
+    double p99_ms;
+};
+
+// results[file][pass]
+typedef std::map<std::string, std::map<std::string, pass_samples>> corpus_results;
+
+static bool read_whole_file(const std::string &path, std::string &contents) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    char chunk[65536];
+    size_t amount_read;
+    while ((amount_read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        contents.append(chunk, amount_read);
+    }
+    fclose(file);
+    return true;
+}
+
+// the options of the module level flags on the "; ./optimizer_executable" first line of text
+static struct optimizer_options options_of_file(const std::string &text) {
+    struct optimizer_options options;
+    const std::string command = "; ./optimizer_executable ";
+    if (text.compare(0, command.size(), command) != 0) {
+        return options;
+    }
+    std::string first_line = text.substr(command.size(), text.find('\n') - command.size());
+    size_t start = 0;
+    while (start < first_line.size()) {
+        size_t end = first_line.find(' ', start);
+        if (end == std::string::npos) end = first_line.size();
+        std::string flag = first_line.substr(start, end - start);
+        if (flag == "--inline") {
+            options.inline_threshold = INLINE_DEFAULT_THRESHOLD;
+        } else if (flag == "--ipcp") {
+            options.interprocedural_constant_propagation = true;
+        } else if (flag == "--specialize") {
+            options.specialization_budget = SPECIALIZATION_DEFAULT_BUDGET;
+        } else if (flag == "--infer-attributes") {
+            options.attribute_inference = true;
+        }
+        start = end + 1;
+    }
+    return options;
+}
+
+// optimizes text in a fresh context and returns the printed result without the ModuleID and
+// source_filename lines
+static std::string optimize_text(const std::string &text, const struct optimizer_options &options) {
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(text.data(), text.size(), "corpus");
+    LLVMModuleRef module = NULL;
+    char *err_message = NULL;
+    if (LLVMParseIRInContext(context, buffer, &module, &err_message)) {
+        fprintf(stderr, "Could not parse a corpus file: %s\n", err_message);
+        exit(1);
+    }
+    optimize(module, options);
+    char *printed = LLVMPrintModuleToString(module);
+    std::string result(printed);
+    LLVMDisposeMessage(printed);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(context);
+    size_t first_line_end = result.find('\n');
+    result = first_line_end == std::string::npos ? result : result.substr(first_line_end + 1);
+    // a hand written X.ll has no source_filename and gets the buffer name, X_opt.ll names X.ll
+    if (result.compare(0, 16, "source_filename ") == 0) {
+        size_t line_end = result.find('\n');
+        result = line_end == std::string::npos ? "" : result.substr(line_end + 1);
+    }
+    return result;
+}
+
+static double percentile(std::vector<double> sorted_samples, double fraction) {
+    std::sort(sorted_samples.begin(), sorted_samples.end());
+    return sorted_samples.empty() ? 0 : sorted_samples[(size_t) ((sorted_samples.size() - 1) * fraction)];
+}
+
+static long peak_memory_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+// baseline lines: "peak_rss_kb N" and "<file> <pass> <median_ms> <p99_ms>", '#' starts a comment
+static bool read_baseline(const char *path, corpus_results &baseline, long &baseline_peak_kb) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char file_name[256], pass_name[256];
+        double median_ms, p99_ms;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "peak_rss_kb %ld", &baseline_peak_kb) == 1) continue;
+        if (sscanf(line, "%255s %255s %lf %lf", file_name, pass_name, &median_ms, &p99_ms) == 4) {
+            baseline[file_name][pass_name].median_ms = median_ms;
+            baseline[file_name][pass_name].p99_ms = p99_ms;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool write_baseline(const char *path, corpus_results &results, long peak_kb, int iterations) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+    fprintf(file, "# corpus_benchmark baseline over %d iterations, regenerate with --write-baseline on the reference machine\n", iterations);
+    fprintf(file, "peak_rss_kb %ld\n", peak_kb);
+    for (auto &file_results : results) {
+        for (auto &pass_results : file_results.second) {
+            fprintf(file, "%s %s %.6f %.6f\n", file_results.first.c_str(), pass_results.first.c_str(), pass_results.second.median_ms, pass_results.second.p99_ms);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool is_regression(double current_ms, double baseline_ms, double threshold_percent, double minimum_ms) {
+    return current_ms > baseline_ms * (1 + threshold_percent / 100) && current_ms - baseline_ms > minimum_ms;
+}
+
+int main(int argc, char *argv[]) {
+    std::string corpus_directory = "optimizer_tests";
+    const char *baseline_path = "benchmarks/corpus_baseline.txt";
+    int iterations = DEFAULT_ITERATIONS;
+    double threshold_percent = DEFAULT_THRESHOLD_PERCENT;
+    bool should_write_baseline = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--corpus") == 0 && has_value) {
+            corpus_directory = argv[++i];
+        } else if (strcmp(argv[i], "--iterations") == 0 && has_value) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold-percent") == 0 && has_value) {
+            threshold_percent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--write-baseline") == 0) {
+            should_write_baseline = true;
+        } else {
+            fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "%s\n", "--iterations should be positive");
+        exit(1);
+    }
+
+    // inputs are the .ll files that are not themselves expected outputs
+    std::vector<std::string> inputs;
+    DIR *directory = opendir(corpus_directory.c_str());
+    if (directory == NULL) {
+        fprintf(stderr, "Could not open the corpus directory %s\n", corpus_directory.c_str());
+        exit(1);
+    }
+    for (struct dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        bool is_ll = name.size() > 3 && name.compare(name.size() - 3, 3, ".ll") == 0;
+        bool is_expected = name.size() > 7 && name.compare(name.size() - 7, 7, "_opt.ll") == 0;
+        if (is_ll && !is_expected) {
+            inputs.push_back(name.substr(0, name.size() - 3));
+        }
+    }
+    closedir(directory);
+    std::sort(inputs.begin(), inputs.end());
+
+    int mismatches = 0;
+    corpus_results results;
+    pass_timing_enabled = true;
+    for (const std::string &input : inputs) {
+        std::string text;
+        read_whole_file(corpus_directory + "/" + input + ".ll", text);
+        struct optimizer_options options = options_of_file(text);
+
+        std::string expected_text;
+        if (read_whole_file(corpus_directory + "/" + input + "_opt.ll", expected_text)) {
+            bool matches = optimize_text(text, options) == optimize_text(expected_text, options);
+            printf("%-24s output %s\n", input.c_str(), matches ? "matches" : "DOES NOT MATCH");
+            mismatches += !matches;
+        } else {
+            printf("%-24s output not checked (no %s_opt.ll)\n", input.c_str(), input.c_str());
+        }
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            pass_timing_reset();
+            optimize_text(text, options);
+            for (size_t p = 0; p < NUMBER_OF_TIMED_PASSES; p++) {
+                results[input][timed_passes[p]].samples_ms.push_back(pass_timing_total_ms(timed_passes[p]));
+            }
+        }
+        for (auto &pass_results : results[input]) {
+            pass_results.second.median_ms = percentile(pass_results.second.samples_ms, 0.5);
+            pass_results.second.p99_ms = percentile(pass_results.second.samples_ms, 0.99);
+        }
+    }
+    long peak_kb = peak_memory_kb();
+
+    printf("\n%-24s %-42s %12s %12s\n", "file", "pass", "median (ms)", "p99 (ms)");
+    for (auto &file_results : results) {
+        for (size_t p = 0; p < NUMBER_OF_TIMED_PASSES; p++) {
+            pass_samples &samples = file_results.second[timed_passes[p]];
+            printf("%-24s %-42s %12.4f %12.4f\n", file_results.first.c_str(), timed_passes[p], samples.median_ms, samples.p99_ms);
+        }
+    }
+    printf("peak memory: %ld KB\n", peak_kb);
+
+    if (should_write_baseline) {
+        if (!write_baseline(baseline_path, results, peak_kb, iterations)) {
+            fprintf(stderr, "Could not write the baseline %s\n", baseline_path);
+            exit(1);
+        }
+        printf("baseline written to %s\n", baseline_path);
+        return mismatches > 0 ? 2 : 0;
+    }
+
+    corpus_results baseline;
+    long baseline_peak_kb = 0;
+    int regressions = 0;
+    if (!read_baseline(baseline_path, baseline, baseline_peak_kb)) {
+        printf("no baseline at %s, only the outputs were checked\n", baseline_path);
+    } else {
+        for (auto &file_results : baseline) {
+            for (auto &pass_results : file_results.second) {
+                if (results.count(file_results.first) == 0 || results[file_results.first].count(pass_results.first) == 0) {
+                    continue;
+                }
+                pass_samples &current = results[file_results.first][pass_results.first];
+                bool median_regressed = is_regression(current.median_ms, pass_results.second.median_ms, threshold_percent, MINIMUM_TIME_REGRESSION_MS);
+                bool p99_regressed = is_regression(current.p99_ms, pass_results.second.p99_ms, P99_TOLERANCE_FACTOR * threshold_percent,
+                                                   P99_TOLERANCE_FACTOR * MINIMUM_TIME_REGRESSION_MS);
+                if (median_regressed || p99_regressed) {
+                    printf("%s %s %s: median %.4f ms (baseline %.4f), p99 %.4f ms (baseline %.4f)\n", median_regressed ? "REGRESSION" : "warning",
+                           file_results.first.c_str(), pass_results.first.c_str(), current.median_ms, pass_results.second.median_ms,
+                           current.p99_ms, pass_results.second.p99_ms);
+                    regressions += median_regressed;
+                }
+            }
+        }
+        if (baseline_peak_kb > 0 && peak_kb > baseline_peak_kb * (1 + threshold_percent / 100)) {
+            printf("REGRESSION peak memory: %ld KB (baseline %ld KB)\n", peak_kb, baseline_peak_kb);
+            regressions++;
+        }
+        printf("%d regressions past %.0f%% of %s\n", regressions, threshold_percent, baseline_path);
+    }
+
+    if (mismatches > 0) {
+        return 2;
+    }
+    return regressions > 0 ? 3 : 0;
+}
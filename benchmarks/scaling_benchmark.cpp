@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <string>
+#include <vector>
+#include "../optimizer.h"
+#include "../pass_timing.h"
+#include "synthetic_ir_generator.h"
+#include "benchmark_passes.h"
+
+// Times every pass on synthetic functions of doubling size and fits time ~ instructions^k
+//
+// ./scaling_benchmark [--scale blocks|allocas|stores|block-size] [--blocks N] [--allocas N]
+//                     [--stores-per-block N] [--loop-nesting N] [--block-size N]
+//                     [--steps N] [--repetitions N] [--seed N] [--dump]
+//
+// --dump prints the generated function at the base size instead of running the benchmark.
+
+// an exponent above this is reported as superlinear (leaves room for timing noise on linear passes)
+#define SUPERLINEAR_EXPONENT_THRESHOLD 1.25
+// times below this are mostly timer noise and are left out of the fit
+#define SMALLEST_FITTED_TIME_MS 0.005
+
+// the passes whose complexity the benchmark was written to watch
+static bool is_watched_pass(const char *pass_name) {
+    return strcmp(pass_name, "run_common_subexpression_elimination") == 0 ||
+           strcmp(pass_name, "compute_kill_set_for_block") == 0 ||
+           strcmp(pass_name, "in_and_out_sets_map") == 0;
+}
+
+struct measurement {
+    unsigned instructions;
+    double pass_ms[NUMBER_OF_TIMED_PASSES];
+};
+
+static unsigned count_instructions(LLVMModuleRef module) {
+    unsigned instructions = 0;
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+                instructions++;
+            }
+        }
+    }
+    return instructions;
+}
+
+static LLVMModuleRef parse_module(LLVMContextRef context, const std::string &text) {
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(text.data(), text.size(), "synthetic");
+    LLVMModuleRef module = NULL;
+    char *err_message = NULL;
+    if (LLVMParseIRInContext(context, buffer, &module, &err_message)) {
+        fprintf(stderr, "The generated IR does not parse: %s\n", err_message);
+        exit(2);
+    }
+    return module;
+}
+
+// least squares slope of log(time) against log(instructions)
+static double growth_exponent(const std::vector<measurement> &measurements, size_t pass_index, size_t &points_used) {
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    points_used = 0;
+    for (const measurement &point : measurements) {
+        if (point.pass_ms[pass_index] < SMALLEST_FITTED_TIME_MS) {
+            continue;
+        }
+        double x = log((double) point.instructions);
+        double y = log(point.pass_ms[pass_index]);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        points_used++;
+    }
+    double denominator = points_used * sum_xx - sum_x * sum_x;
+    if (points_used < 3 || denominator == 0) {
+        return NAN;
+    }
+    return (points_used * sum_xy - sum_x * sum_y) / denominator;
+}
+
+int main(int argc, char *argv[]) {
+    synthetic_function_shape base_shape = {8, 8, 4, 1, 12, 1};
+    const char *scaled_dimension = "blocks";
+    unsigned steps = 6;
+    unsigned repetitions = 5;
+    bool dump_only = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--dump") == 0) {
+            dump_only = true;
+        } else if (strcmp(argv[i], "--scale") == 0 && has_value) {
+            scaled_dimension = argv[++i];
+        } else if (strcmp(argv[i], "--blocks") == 0 && has_value) {
+            base_shape.number_of_blocks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--allocas") == 0 && has_value) {
+            base_shape.number_of_allocas = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stores-per-block") == 0 && has_value) {
+            base_shape.stores_per_block = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loop-nesting") == 0 && has_value) {
+            base_shape.loop_nesting = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--block-size") == 0 && has_value) {
+            base_shape.instructions_per_block = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && has_value) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repetitions") == 0 && has_value) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            base_shape.seed = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (dump_only) {
+        fputs(generate_synthetic_module(base_shape).c_str(), stdout);
+        return 0;
+    }
+
+    unsigned *scaled_field = NULL;
+    synthetic_function_shape shape = base_shape;
+    if (strcmp(scaled_dimension, "blocks") == 0) scaled_field = &shape.number_of_blocks;
+    else if (strcmp(scaled_dimension, "allocas") == 0) scaled_field = &shape.number_of_allocas;
+    else if (strcmp(scaled_dimension, "stores") == 0) scaled_field = &shape.stores_per_block;
+    else if (strcmp(scaled_dimension, "block-size") == 0) scaled_field = &shape.instructions_per_block;
+    if (scaled_field == NULL || steps == 0 || repetitions == 0) {
+        fprintf(stderr, "%s\n", "--scale should be blocks, allocas, stores or block-size and steps and repetitions positive");
+        exit(1);
+    }
+
+    pass_timing_enabled = true;
+    std::vector<measurement> measurements;
+    unsigned base_value = *scaled_field;
+    for (unsigned step = 0; step < steps; step++) {
+        *scaled_field = base_value << step;
+        std::string text = generate_synthetic_module(shape);
+
+        // the fastest repetition is kept, slower ones only add scheduling noise
+        measurement point;
+        for (size_t p = 0; p < NUMBER_OF_TIMED_PASSES; p++) point.pass_ms[p] = INFINITY;
+        for (unsigned repetition = 0; repetition < repetitions; repetition++) {
+            LLVMContextRef context = LLVMContextCreate();
+            LLVMModuleRef module = parse_module(context, text);
+            point.instructions = count_instructions(module);
+            pass_timing_reset();
+            optimize(module);
+            for (size_t p = 0; p < NUMBER_OF_TIMED_PASSES; p++) {
+                double elapsed_ms = pass_timing_total_ms(timed_passes[p]);
+                if (elapsed_ms < point.pass_ms[p]) point.pass_ms[p] = elapsed_ms;
+            }
+            LLVMDisposeModule(module);
+            LLVMContextDispose(context);
+        }
+        measurements.push_back(point);
+    }
+
+    printf("scaling %s from %u to %u (%u repetitions, fastest kept), times in ms\n", scaled_dimension, base_value, base_value << (steps - 1), repetitions);
+    printf("%-42s", "instructions");
+    for (const measurement &point : measurements) printf("%11u", point.instructions);
+    printf("%10s\n", "exponent");
+
+    int superlinear_passes = 0;
+    for (size_t p = 0; p < NUMBER_OF_TIMED_PASSES; p++) {
+        printf("%-42s", timed_passes[p]);
+        for (const measurement &point : measurements) printf("%11.3f", point.pass_ms[p]);
+        size_t points_used;
+        double exponent = growth_exponent(measurements, p, points_used);
+        if (isnan(exponent)) {
+            printf("%10s\n", "n/a");
+            continue;
+        }
+        bool superlinear = exponent > SUPERLINEAR_EXPONENT_THRESHOLD;
+        superlinear_passes += superlinear;
+        printf("%10.2f%s%s\n", exponent, superlinear ? "  SUPERLINEAR" : "", superlinear && is_watched_pass(timed_passes[p]) ? " (watched)" : "");
+    }
+    printf("%d passes grow faster than instructions^%.2f\n", superlinear_passes, SUPERLINEAR_EXPONENT_THRESHOLD);
+    return 0;
+}
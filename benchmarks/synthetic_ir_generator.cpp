@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "synthetic_ir_generator.h"
+
+// small deterministic generator so a shape and a seed always give the same function
+static unsigned next_random(unsigned &state, unsigned bound) {
+    state = state * 1103515245u + 12345u;
+    return ((state >> 16) & 0x7fff) % bound;
+}
+
+struct text_builder {
+    std::string text;
+    unsigned next_value = 0;
+
+    std::string new_value() { return "%v" + std::to_string(next_value++); }
+    void line(const std::string &instruction) { text += "  " + instruction + "\n"; }
+    void label(const std::string &name) { text += "\n" + name + ":\n"; }
+};
+
+static std::string local_variable(unsigned index) { return "%local" + std::to_string(index); }
+static std::string loop_counter(unsigned depth) { return "%counter" + std::to_string(depth); }
+static std::string body_block(unsigned index) { return "body" + std::to_string(index); }
+static std::string loop_header(unsigned depth) { return "header" + std::to_string(depth); }
+static std::string loop_latch(unsigned depth) { return "latch" + std::to_string(depth); }
+
+// loads, arithmetic (with some constant only operations and some repeated expressions) and stores,
+// mixed in a random order like clang emits for a sequence of assignments
+static void fill_body_block(text_builder &builder, const synthetic_function_shape &shape, unsigned &random_state) {
+    std::vector<std::string> values_in_block;
+    std::string last_expression;
+    unsigned stores_left = shape.stores_per_block;
+    unsigned instructions_left = shape.instructions_per_block;
+    static const char *operations[] = {"add nsw", "sub nsw", "mul nsw"};
+
+    while (stores_left > 0 || instructions_left > 0) {
+        bool emit_store = stores_left > 0 && (instructions_left == 0 || next_random(random_state, stores_left + instructions_left) < stores_left);
+        if (emit_store) {
+            std::string stored = values_in_block.empty() || next_random(random_state, 3) == 0
+                                     ? std::to_string(next_random(random_state, 100))
+                                     : values_in_block[next_random(random_state, values_in_block.size())];
+            builder.line("store i32 " + stored + ", ptr " + local_variable(next_random(random_state, shape.number_of_allocas)) + ", align 4");
+            stores_left--;
+            continue;
+        }
+
+        std::string value = builder.new_value();
+        unsigned kind = next_random(random_state, 10);
+        if (values_in_block.size() < 2 || kind < 4) {
+            builder.line(value + " = load i32, ptr " + local_variable(next_random(random_state, shape.number_of_allocas)) + ", align 4");
+        } else if (kind == 4 && !last_expression.empty()) {
+            builder.line(value + " = " + last_expression); // common subexpression
+        } else {
+            std::string first = kind == 5 ? std::to_string(next_random(random_state, 50)) : values_in_block[next_random(random_state, values_in_block.size())];
+            std::string second = kind <= 6 ? std::to_string(next_random(random_state, 50)) : values_in_block[next_random(random_state, values_in_block.size())];
+            last_expression = std::string(operations[next_random(random_state, 3)]) + " i32 " + first + ", " + second;
+            builder.line(value + " = " + last_expression);
+        }
+        values_in_block.push_back(value);
+        instructions_left--;
+    }
+}
+
+std::string generate_synthetic_module(struct synthetic_function_shape shape) {
+    if (shape.number_of_blocks == 0) shape.number_of_blocks = 1;
+    if (shape.number_of_allocas == 0) shape.number_of_allocas = 1;
+    unsigned random_state = shape.seed;
+    text_builder builder;
+
+    builder.text = "; generated by synthetic_ir_generator\n"
+                   "declare void @print(i32)\n\n"
+                   "define i32 @synthetic(i32 %argument) {\n";
+    for (unsigned i = 0; i < shape.number_of_allocas; i++) {
+        builder.line(local_variable(i) + " = alloca i32, align 4");
+    }
+    for (unsigned depth = 0; depth < shape.loop_nesting; depth++) {
+        builder.line(loop_counter(depth) + " = alloca i32, align 4");
+    }
+    builder.line("store i32 %argument, ptr " + local_variable(0) + ", align 4");
+    for (unsigned i = 1; i < shape.number_of_allocas; i++) {
+        builder.line("store i32 " + std::to_string(next_random(random_state, 100)) + ", ptr " + local_variable(i) + ", align 4");
+    }
+    for (unsigned depth = 0; depth < shape.loop_nesting; depth++) {
+        builder.line("store i32 0, ptr " + loop_counter(depth) + ", align 4");
+    }
+    std::string first_block = shape.loop_nesting > 0 ? loop_header(0) : body_block(0);
+    std::string after_body = shape.loop_nesting > 0 ? loop_latch(shape.loop_nesting - 1) : "exit";
+    builder.line("br label %" + first_block);
+
+    // header k enters loop k + 1 (or the body) and leaves to the latch of loop k - 1 (or the exit)
+    for (unsigned depth = 0; depth < shape.loop_nesting; depth++) {
+        builder.label(loop_header(depth));
+        std::string counter = builder.new_value();
+        std::string bound = builder.new_value();
+        std::string condition = builder.new_value();
+        builder.line(counter + " = load i32, ptr " + loop_counter(depth) + ", align 4");
+        builder.line(bound + " = load i32, ptr " + local_variable(0) + ", align 4");
+        builder.line(condition + " = icmp slt i32 " + counter + ", " + bound);
+        std::string inside = depth + 1 < shape.loop_nesting ? loop_header(depth + 1) : body_block(0);
+        std::string outside = depth == 0 ? "exit" : loop_latch(depth - 1);
+        builder.line("br i1 " + condition + ", label %" + inside + ", label %" + outside);
+    }
+
+    // body blocks either fall to the next one or branch over it, which creates merge points
+    for (unsigned i = 0; i < shape.number_of_blocks; i++) {
+        builder.label(body_block(i));
+        fill_body_block(builder, shape, random_state);
+        std::string next = i + 1 < shape.number_of_blocks ? body_block(i + 1) : after_body;
+        if (i + 2 < shape.number_of_blocks && next_random(random_state, 2) == 0) {
+            std::string loaded = builder.new_value();
+            std::string condition = builder.new_value();
+            builder.line(loaded + " = load i32, ptr " + local_variable(next_random(random_state, shape.number_of_allocas)) + ", align 4");
+            builder.line(condition + " = icmp sgt i32 " + loaded + ", " + std::to_string(next_random(random_state, 100)));
+            builder.line("br i1 " + condition + ", label %" + next + ", label %" + body_block(i + 2));
+        } else {
+            builder.line("br label %" + next);
+        }
+    }
+
+    for (unsigned depth = shape.loop_nesting; depth-- > 0;) {
+        builder.label(loop_latch(depth));
+        std::string counter = builder.new_value();
+        std::string incremented = builder.new_value();
+        builder.line(counter + " = load i32, ptr " + loop_counter(depth) + ", align 4");
+        builder.line(incremented + " = add nsw i32 " + counter + ", 1");
+        builder.line("store i32 " + incremented + ", ptr " + loop_counter(depth) + ", align 4");
+        builder.line("br label %" + loop_header(depth));
+    }
+
+    builder.label("exit");
+    std::string printed = builder.new_value();
+    builder.line(printed + " = load i32, ptr " + local_variable(next_random(random_state, shape.number_of_allocas)) + ", align 4");
+    builder.line("call void @print(i32 " + printed + ")");
+    builder.line("ret i32 " + printed);
+    builder.text += "}\n";
+    return builder.text;
+}
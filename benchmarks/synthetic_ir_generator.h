@@ -0,0 +1,23 @@
+#ifndef SYNTHETIC_IR_GENERATOR_H
+#define SYNTHETIC_IR_GENERATOR_H
+
+#include <string>
+
+// Generator of -O0 style functions (every variable lives in an alloca, every use reloads it) used
+// to measure how the passes scale. The same parameters and seed always give the same function.
+
+struct synthetic_function_shape {
+    unsigned number_of_blocks;     // straight line blocks inside the innermost loop
+    unsigned number_of_allocas;    // local variables, all allocated in the entry block
+    unsigned stores_per_block;     // stores to the locals in each block
+    unsigned loop_nesting;         // loops wrapped around the blocks, 0 for no loop
+    unsigned instructions_per_block; // loads and arithmetic in each block besides the stores
+    unsigned seed;
+};
+
+// textual IR of a module holding one function, i32 @synthetic(i32), and a declaration of @print.
+// Text is produced instead of going through LLVMBuild* because the builder would fold the
+// constant arithmetic that -O0 code is full of and that the passes are meant to fold.
+std::string generate_synthetic_module(struct synthetic_function_shape shape);
+
+#endif
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <utility>
+#include "call_graph.h"
+#include "pass_timing.h"
+
+#define NOT_VISITED ((unsigned) -1)
+
+LLVMValueRef called_function_with_body(LLVMValueRef call) {
+    if (LLVMIsACallInst(call) == NULL) {
+        return NULL;
+    }
+    LLVMValueRef callee = LLVMGetCalledValue(call);
+    if (LLVMIsAFunction(callee) == NULL || LLVMCountBasicBlocks(callee) == 0) {
+        return NULL;
+    }
+    return callee;
+}
+
+// Tarjan's algorithm with an explicit stack, a long chain of calls must not overflow the real one
+static void find_strongly_connected_components(struct call_graph &graph) {
+    size_t number_of_functions = graph.functions.size();
+    std::vector<unsigned> index(number_of_functions, NOT_VISITED);
+    std::vector<unsigned> lowlink(number_of_functions);
+    std::vector<bool> is_on_stack(number_of_functions, false);
+    std::vector<unsigned> component_stack;
+    std::vector<std::pair<unsigned, size_t>> visit_stack; // function and the next of its callees to look at
+    unsigned next_index = 0;
+    graph.scc_of.assign(number_of_functions, 0);
+    for (unsigned root = 0; root < number_of_functions; root++) {
+        if (index[root] != NOT_VISITED) continue;
+        index[root] = lowlink[root] = next_index++;
+        component_stack.push_back(root);
+        is_on_stack[root] = true;
+        visit_stack.push_back(std::make_pair(root, (size_t) 0));
+        while (!visit_stack.empty()) {
+            unsigned function = visit_stack.back().first;
+            size_t &next_callee = visit_stack.back().second;
+            if (next_callee < graph.callees[function].size()) {
+                unsigned callee = graph.callees[function][next_callee++];
+                if (index[callee] == NOT_VISITED) {
+                    index[callee] = lowlink[callee] = next_index++;
+                    component_stack.push_back(callee);
+                    is_on_stack[callee] = true;
+                    visit_stack.push_back(std::make_pair(callee, (size_t) 0));
+                } else if (is_on_stack[callee]) {
+                    lowlink[function] = std::min(lowlink[function], index[callee]);
+                }
+                continue;
+            }
+            visit_stack.pop_back();
+            if (!visit_stack.empty()) {
+                unsigned caller = visit_stack.back().first;
+                lowlink[caller] = std::min(lowlink[caller], lowlink[function]);
+            }
+            if (lowlink[function] != index[function]) continue;
+            // function is the root of a component, which is everything above it on the stack
+            std::vector<unsigned> component;
+            unsigned member;
+            do {
+                member = component_stack.back();
+                component_stack.pop_back();
+                is_on_stack[member] = false;
+                graph.scc_of[member] = graph.sccs.size();
+                component.push_back(member);
+            } while (member != function);
+            std::sort(component.begin(), component.end());
+            graph.sccs.push_back(component);
+        }
+    }
+}
+
+void build_call_graph(LLVMModuleRef module, struct call_graph &graph) {
+    scoped_pass_timer timer("call_graph");
+    graph.functions.clear();
+    graph.callees.clear();
+    graph.sccs.clear();
+    graph.index_of.clear();
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (LLVMCountBasicBlocks(func) == 0) continue;
+        graph.index_of[func] = graph.functions.size();
+        graph.functions.push_back(func);
+    }
+    graph.callees.resize(graph.functions.size());
+    for (unsigned caller = 0; caller < graph.functions.size(); caller++) {
+        std::vector<unsigned> &callees = graph.callees[caller];
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(graph.functions[caller]); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+                LLVMValueRef callee = called_function_with_body(ins);
+                if (callee != NULL) {
+                    callees.push_back(graph.index_of[callee]);
+                }
+            }
+        }
+        std::sort(callees.begin(), callees.end());
+        callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+    }
+    find_strongly_connected_components(graph);
+}
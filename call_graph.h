@@ -0,0 +1,29 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <llvm-c/Core.h>
+#include <unordered_map>
+#include <vector>
+
+// Call graph of the functions defined in a module
+//
+// An edge goes from a function to every function with a body it calls directly. Calls through a
+// pointer and calls to declarations add no edge. The strongly connected components are found
+// with Tarjan's algorithm, which emits a component only after every component it calls into, so
+// sccs is already bottom-up: callees come before their callers, and the functions of a recursive
+// cycle share one component.
+
+struct call_graph {
+    std::vector<LLVMValueRef> functions;          // the functions with a body, in module order
+    std::vector<std::vector<unsigned>> callees;   // indices into functions, each callee once
+    std::vector<std::vector<unsigned>> sccs;      // bottom-up, each one in module order
+    std::vector<unsigned> scc_of;                 // index into sccs of every function
+    std::unordered_map<LLVMValueRef, unsigned> index_of; // the index of every function in functions
+};
+
+void build_call_graph(LLVMModuleRef module, struct call_graph &graph);
+
+// the function with a body that call calls directly, NULL for anything else
+LLVMValueRef called_function_with_body(LLVMValueRef call);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef COMPILE_BUDGET_H
+#define COMPILE_BUDGET_H
+
+#include <atomic>
+#include "pass_timing.h"
+
+// Per function compile time limits
+//
+// A function over the size limits never goes through the pipeline. The round limits and the wall
+// time are checked at round boundaries: the IN and OUT computation and the fixed points stop
+// there, what was already written to the IR stays (every pass leaves the function valid between
+// two rounds) and nothing is concluded from an unfinished analysis. In both cases the function
+// then goes through the linear local passes of PIPELINE_DEGRADED and is reported as degraded.
+// Everything but the wall time is counted, so with those limits the results are reproducible.
+//
+// The same checks stop a function when the caller cancels it or its deadline passes. That is an
+// interruption, not a limit: the function is left as the last round left it and nothing else runs.
+
+#define PIPELINE_DEGRADED "constant-folding,dce"
+
+struct compile_budget {
+    unsigned maximum_instructions = 0; // 0 for no limit, for all the fields
+    unsigned maximum_stores = 0;
+    unsigned maximum_dataflow_rounds = 0;    // of one IN and OUT computation
+    unsigned maximum_fixed_point_rounds = 0; // of one fixed-point group or global propagation
+    double maximum_milliseconds = 0;
+};
+
+struct compile_budget_tracker {
+    struct compile_budget limits; // no limits unless set
+    long long start_ns = 0;
+    const std::atomic<bool> *cancellation = NULL; // stops the function once another thread sets it
+    long long deadline_ns = 0;                    // on the pass_timing_now_ns() clock, 0 for none
+    const char *exceeded_limit = NULL; // the first limit hit, NULL while within budget
+    bool was_interrupted = false;      // the limit is the cancellation or the deadline
+
+    // true once a limit was hit, the cancellation and the clock are checked on every call
+    bool is_exhausted() {
+        if (exceeded_limit != NULL) {
+            return true;
+        }
+        if (cancellation != NULL && cancellation->load(std::memory_order_relaxed)) {
+            exceeded_limit = "cancellation";
+            was_interrupted = true;
+        } else if (deadline_ns != 0 || limits.maximum_milliseconds > 0) {
+            long long now_ns = pass_timing_now_ns();
+            if (deadline_ns != 0 && now_ns > deadline_ns) {
+                exceeded_limit = "deadline";
+                was_interrupted = true;
+            } else if (limits.maximum_milliseconds > 0 && now_ns - start_ns > limits.maximum_milliseconds * 1e6) {
+                exceeded_limit = "time";
+            }
+        }
+        return exceeded_limit != NULL;
+    }
+
+    // called before round number round (counting from 1) of a loop limited to maximum rounds
+    bool allows_round(unsigned long long round, unsigned maximum, const char *limit_name) {
+        if (exceeded_limit == NULL && maximum != 0 && round > maximum) {
+            exceeded_limit = limit_name;
+        }
+        return !is_exhausted();
+    }
+};
+
+#endif
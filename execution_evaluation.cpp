@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Target.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "execution_evaluation.h"
+
+// one [number of functions x i64] array per kind of counter, indexed by the function position
+#define NUMBER_OF_COUNTER_KINDS 3
+static const char *counter_array_names[NUMBER_OF_COUNTER_KINDS] = {
+    "__evaluation_executed_instructions",
+    "__evaluation_executed_loads",
+    "__evaluation_executed_stores",
+};
+
+struct function_counts {
+    std::string function_name;
+    unsigned long long executed[NUMBER_OF_COUNTER_KINDS];
+};
+
+struct run_result {
+    bool returns_value;
+    int return_value;
+    std::vector<int> printed_values;
+    std::vector<function_counts> counts;
+};
+
+// state of the run in progress, used by the print and read helpers the JIT code calls
+static std::vector<int> *printed_values_of_current_run = NULL;
+static const std::vector<int> *read_values_of_current_run = NULL;
+static size_t next_read_value = 0;
+
+static void evaluation_print(int value) {
+    printed_values_of_current_run->push_back(value);
+}
+
+static int evaluation_read() {
+    if (next_read_value < read_values_of_current_run->size()) {
+        return (*read_values_of_current_run)[next_read_value++];
+    }
+    return 0;
+}
+
+bool parse_integer_list(const char *text, std::vector<int> &values) {
+    const char *cursor = text;
+    while (*cursor != '\0') {
+        char *end;
+        long value = strtol(cursor, &end, 10);
+        if (end == cursor || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        values.push_back((int) value);
+        cursor = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
+// adds to the start of every block the number of instructions, loads and stores the block holds,
+// counted before the counters themselves are inserted
+static std::vector<std::string> instrument_module(LLVMModuleRef module) {
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(context);
+
+    std::vector<LLVMValueRef> defined_functions;
+    std::vector<std::string> function_names;
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (LLVMCountBasicBlocks(func) != 0) {
+            size_t name_length;
+            const char *name = LLVMGetValueName2(func, &name_length);
+            defined_functions.push_back(func);
+            function_names.push_back(std::string(name, name_length));
+        }
+    }
+
+    LLVMTypeRef array_type = LLVMArrayType(i64, defined_functions.size());
+    LLVMValueRef counter_arrays[NUMBER_OF_COUNTER_KINDS];
+    for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+        counter_arrays[kind] = LLVMAddGlobal(module, array_type, counter_array_names[kind]);
+        LLVMSetInitializer(counter_arrays[kind], LLVMConstNull(array_type));
+    }
+
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+    for (size_t function_index = 0; function_index < defined_functions.size(); function_index++) {
+        LLVMValueRef func = defined_functions[function_index];
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            unsigned long long block_counts[NUMBER_OF_COUNTER_KINDS] = {0, 0, 0};
+            for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+                block_counts[0]++;
+                if (LLVMGetInstructionOpcode(ins) == LLVMLoad) block_counts[1]++;
+                if (LLVMGetInstructionOpcode(ins) == LLVMStore) block_counts[2]++;
+            }
+
+            // phi nodes have to stay at the top of the block
+            LLVMValueRef insertion_point = LLVMGetFirstInstruction(bb);
+            while (insertion_point != NULL && LLVMIsAPHINode(insertion_point) != NULL) {
+                insertion_point = LLVMGetNextInstruction(insertion_point);
+            }
+            if (insertion_point == NULL) {
+                continue;
+            }
+            LLVMPositionBuilderBefore(builder, insertion_point);
+            for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+                if (block_counts[kind] == 0) {
+                    continue;
+                }
+                LLVMValueRef indices[2] = {LLVMConstInt(i64, 0, 0), LLVMConstInt(i64, function_index, 0)};
+                LLVMValueRef counter = LLVMBuildInBoundsGEP2(builder, array_type, counter_arrays[kind], indices, 2, "");
+                LLVMValueRef old_count = LLVMBuildLoad2(builder, i64, counter, "");
+                LLVMValueRef new_count = LLVMBuildAdd(builder, old_count, LLVMConstInt(i64, block_counts[kind], 0), "");
+                LLVMBuildStore(builder, new_count, counter);
+            }
+        }
+    }
+    LLVMDisposeBuilder(builder);
+    return function_names;
+}
+
+// instruments, compiles and runs module (which is consumed), false with a message on failure
+static bool run_module(LLVMModuleRef module, const struct evaluation_options &options, run_result &result, std::string &error) {
+    std::vector<std::string> function_names = instrument_module(module);
+
+    // the inputs were produced for some other machine, the JIT compiles for this one
+    char *host_triple = LLVMGetDefaultTargetTriple();
+    LLVMSetTarget(module, host_triple);
+    LLVMDisposeMessage(host_triple);
+
+    LLVMValueRef entry = LLVMGetNamedFunction(module, options.entry_function_name);
+    if (entry == NULL || LLVMCountBasicBlocks(entry) == 0) {
+        error = std::string("there is no function ") + options.entry_function_name + " to call";
+        LLVMDisposeModule(module);
+        return false;
+    }
+    LLVMTypeRef entry_type = LLVMGlobalGetValueType(entry);
+    LLVMTypeRef return_type = LLVMGetReturnType(entry_type);
+    result.returns_value = LLVMGetTypeKind(return_type) != LLVMVoidTypeKind;
+    bool signature_is_supported = LLVMCountParamTypes(entry_type) == options.entry_arguments.size() &&
+                                  options.entry_arguments.size() <= MAXIMUM_ENTRY_ARGUMENTS && !LLVMIsFunctionVarArg(entry_type) &&
+                                  (!result.returns_value || (LLVMGetTypeKind(return_type) == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(return_type) == 32));
+    for (unsigned i = 0; i < LLVMCountParams(entry); i++) {
+        LLVMTypeRef parameter_type = LLVMTypeOf(LLVMGetParam(entry, i));
+        signature_is_supported = signature_is_supported && LLVMGetTypeKind(parameter_type) == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(parameter_type) == 32;
+    }
+    if (!signature_is_supported) {
+        error = "the entry function should take as many i32 arguments as given (at most 4) and return i32 or void";
+        LLVMDisposeModule(module);
+        return false;
+    }
+
+    struct LLVMMCJITCompilerOptions compiler_options;
+    LLVMInitializeMCJITCompilerOptions(&compiler_options, sizeof(compiler_options));
+    compiler_options.OptLevel = 0; // the backend must not change what the counters measure
+    LLVMExecutionEngineRef engine;
+    char *err_message = NULL;
+    if (LLVMCreateMCJITCompilerForModule(&engine, module, &compiler_options, sizeof(compiler_options), &err_message)) {
+        error = err_message;
+        LLVMDisposeMessage(err_message);
+        return false;
+    }
+
+    // print and read resolve to the evaluator's helpers rather than to whatever the process has
+    LLVMValueRef print_declaration = LLVMGetNamedFunction(module, "print");
+    LLVMValueRef read_declaration = LLVMGetNamedFunction(module, "read");
+    if (print_declaration != NULL && LLVMCountBasicBlocks(print_declaration) == 0) {
+        LLVMAddGlobalMapping(engine, print_declaration, (void *) evaluation_print);
+    }
+    if (read_declaration != NULL && LLVMCountBasicBlocks(read_declaration) == 0) {
+        LLVMAddGlobalMapping(engine, read_declaration, (void *) evaluation_read);
+    }
+
+    uint64_t entry_address = LLVMGetFunctionAddress(engine, options.entry_function_name);
+    if (entry_address == 0) {
+        error = "the JIT could not compile the entry function";
+        LLVMDisposeExecutionEngine(engine);
+        return false;
+    }
+
+    printed_values_of_current_run = &result.printed_values;
+    read_values_of_current_run = &options.read_values;
+    next_read_value = 0;
+    const std::vector<int> &a = options.entry_arguments;
+    int return_value = 0;
+    switch (a.size()) {
+        case 0: return_value = ((int (*)()) entry_address)(); break;
+        case 1: return_value = ((int (*)(int)) entry_address)(a[0]); break;
+        case 2: return_value = ((int (*)(int, int)) entry_address)(a[0], a[1]); break;
+        case 3: return_value = ((int (*)(int, int, int)) entry_address)(a[0], a[1], a[2]); break;
+        case 4: return_value = ((int (*)(int, int, int, int)) entry_address)(a[0], a[1], a[2], a[3]); break;
+    }
+    result.return_value = result.returns_value ? return_value : 0;
+
+    for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+        const unsigned long long *counters = (const unsigned long long *) LLVMGetGlobalValueAddress(engine, counter_array_names[kind]);
+        for (size_t i = 0; i < function_names.size(); i++) {
+            if (kind == 0) {
+                function_counts counts = {function_names[i], {0, 0, 0}};
+                result.counts.push_back(counts);
+            }
+            result.counts[i].executed[kind] = counters != NULL ? counters[i] : 0;
+        }
+    }
+    LLVMDisposeExecutionEngine(engine); // also disposes the module
+    return true;
+}
+
+static void print_reduction(FILE *report, unsigned long long original, unsigned long long optimized) {
+    double reduction = original == 0 ? 0 : 100.0 * ((double) original - (double) optimized) / original;
+    fprintf(report, " %10llu %10llu %7.1f%%", original, optimized, reduction);
+}
+
+// one function, either side NULL when the function only exists in the other module, as when
+// linking removed it or the specialization added it
+static void print_function_row(FILE *report, const std::string &function_name, const struct function_counts *original,
+                               const struct function_counts *optimized, unsigned long long *original_totals,
+                               unsigned long long *optimized_totals) {
+    fprintf(report, "%-24s", function_name.c_str());
+    for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+        if (original != NULL && optimized != NULL) {
+            print_reduction(report, original->executed[kind], optimized->executed[kind]);
+        } else if (original != NULL) {
+            fprintf(report, " %10llu %10s %8s", original->executed[kind], "-", "");
+        } else {
+            fprintf(report, " %10s %10llu %8s", "-", optimized->executed[kind], "");
+        }
+        original_totals[kind] += original != NULL ? original->executed[kind] : 0;
+        optimized_totals[kind] += optimized != NULL ? optimized->executed[kind] : 0;
+    }
+    fprintf(report, "%s\n", original == NULL ? "  (only optimized)" : optimized == NULL ? "  (only original)" : "");
+}
+
+bool evaluate_optimization(LLVMModuleRef original, LLVMModuleRef optimized, const struct evaluation_options &options, FILE *report) {
+    static bool jit_is_initialized = false;
+    if (!jit_is_initialized) {
+        LLVMLinkInMCJIT();
+        LLVMInitializeNativeTarget();
+        LLVMInitializeNativeAsmPrinter();
+        jit_is_initialized = true;
+    }
+
+    run_result original_result;
+    run_result optimized_result;
+    std::string error;
+    if (!run_module(original, options, original_result, error)) {
+        LLVMDisposeModule(optimized);
+        fprintf(report, "Could not run the original module: %s\n", error.c_str());
+        return false;
+    }
+    if (!run_module(optimized, options, optimized_result, error)) {
+        fprintf(report, "Could not run the optimized module: %s\n", error.c_str());
+        return false;
+    }
+
+    fprintf(report, "%-24s %32s %32s %32s\n", "", "executed instructions", "executed loads", "executed stores");
+    fprintf(report, "%-24s", "function");
+    for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+        fprintf(report, " %10s %10s %8s", "original", "optimized", "saved");
+    }
+    fprintf(report, "\n");
+    unsigned long long original_totals[NUMBER_OF_COUNTER_KINDS] = {0, 0, 0};
+    unsigned long long optimized_totals[NUMBER_OF_COUNTER_KINDS] = {0, 0, 0};
+    // rows are matched by name, the functions of the original first and then the ones only the
+    // optimized module has
+    std::unordered_map<std::string, size_t> optimized_row_of;
+    for (size_t i = 0; i < optimized_result.counts.size(); i++) {
+        optimized_row_of[optimized_result.counts[i].function_name] = i;
+    }
+    std::vector<bool> is_optimized_row_printed(optimized_result.counts.size(), false);
+    for (const struct function_counts &counts : original_result.counts) {
+        auto optimized_row = optimized_row_of.find(counts.function_name);
+        const struct function_counts *optimized_counts = NULL;
+        if (optimized_row != optimized_row_of.end()) {
+            optimized_counts = &optimized_result.counts[optimized_row->second];
+            is_optimized_row_printed[optimized_row->second] = true;
+        }
+        print_function_row(report, counts.function_name, &counts, optimized_counts, original_totals, optimized_totals);
+    }
+    for (size_t i = 0; i < optimized_result.counts.size(); i++) {
+        if (!is_optimized_row_printed[i]) {
+            print_function_row(report, optimized_result.counts[i].function_name, NULL, &optimized_result.counts[i],
+                               original_totals, optimized_totals);
+        }
+    }
+    fprintf(report, "%-24s", "total");
+    for (int kind = 0; kind < NUMBER_OF_COUNTER_KINDS; kind++) {
+        print_reduction(report, original_totals[kind], optimized_totals[kind]);
+    }
+    fprintf(report, "\n");
+
+    bool same_behavior = original_result.printed_values == optimized_result.printed_values &&
+                         original_result.return_value == optimized_result.return_value;
+    fprintf(report, "printed values:");
+    for (int value : original_result.printed_values) fprintf(report, " %d", value);
+    if (original_result.returns_value) fprintf(report, ", returned %d", original_result.return_value);
+    fprintf(report, "\n");
+    if (same_behavior) {
+        fprintf(report, "%s\n", "the optimized module printed and returned the same values");
+    } else {
+        fprintf(report, "MISMATCH the optimized module printed:");
+        for (int value : optimized_result.printed_values) fprintf(report, " %d", value);
+        if (optimized_result.returns_value) fprintf(report, ", returned %d", optimized_result.return_value);
+        fprintf(report, "\n");
+    }
+    return same_behavior;
+}
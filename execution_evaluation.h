@@ -0,0 +1,31 @@
+#ifndef EXECUTION_EVALUATION_H
+#define EXECUTION_EVALUATION_H
+
+#include <stdio.h>
+#include <llvm-c/Core.h>
+#include <vector>
+
+// Measures what the optimization is worth by running the code
+//
+// The original and the optimized module are instrumented with per block counters, JIT compiled
+// with MCJIT and the entry function is called on both. print and read, the helpers defined in
+// optimizer_tests/main.c, are provided by the evaluator: print records the value and read hands
+// out the given input values in order (0 once they run out). The executed instructions, loads and
+// stores of every function are reported side by side, and the printed values and the return
+// value of both runs must be the same.
+
+#define MAXIMUM_ENTRY_ARGUMENTS 4 // the entry takes up to this many i32 arguments and returns i32 or void
+
+struct evaluation_options {
+    const char *entry_function_name;
+    std::vector<int> entry_arguments;
+    std::vector<int> read_values;
+};
+
+// parses "5" or "1,2,3" as given on the command line, false if something is not an integer
+bool parse_integer_list(const char *text, std::vector<int> &values);
+
+// both modules are consumed, returns true if the two runs behaved the same
+bool evaluate_optimization(LLVMModuleRef original, LLVMModuleRef optimized, const struct evaluation_options &options, FILE *report);
+
+#endif
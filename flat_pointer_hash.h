@@ -0,0 +1,377 @@
+#ifndef FLAT_POINTER_HASH_H
+#define FLAT_POINTER_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "function_arena.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open addressing hash set and map for pointer keys (LLVMValueRef, LLVMBasicBlockRef)
+//
+// The layout follows the SwissTable idea: one control byte per slot, either empty, deleted or the
+// low 7 bits of the key's hash, and the slots in a separate flat array. Slots are probed a group
+// of 16 control bytes at a time (one SSE2 compare when available), so most lookups touch one cache
+// line of control bytes and one slot, with no node to chase. Copying a set is two memcpy calls,
+// which is what the reaching definitions fixed point does most.
+//
+// The memory comes from the function arena when the table is created inside a
+// function_arena_scope, and from the heap otherwise.
+// Iteration order is the slot order, which is unspecified like std::unordered_set's.
+
+#define FLAT_HASH_GROUP_SIZE 16
+#define FLAT_HASH_MINIMUM_CAPACITY 16
+#define FLAT_HASH_EMPTY ((signed char) -128)
+#define FLAT_HASH_DELETED ((signed char) -2)
+
+// LLVM objects are at least 8 byte aligned, so the low bits of a pointer say little; the
+// multiply spreads the other bits over the whole word (the finalizer of MurmurHash3)
+static inline uint64_t mix_pointer_hash(const void *pointer) {
+    uint64_t hash = (uint64_t) (uintptr_t) pointer;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// bit i of the results is set when control byte i of the group qualifies
+static inline unsigned flat_hash_match_byte(const signed char *group, signed char byte) {
+#if defined(__SSE2__)
+    __m128i control = _mm_loadu_si128((const __m128i *) group);
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(byte)));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < FLAT_HASH_GROUP_SIZE; i++) {
+        mask |= (unsigned) (group[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+static inline unsigned flat_hash_match_empty_or_deleted(const signed char *group) {
+#if defined(__SSE2__)
+    // empty and deleted are the only negative control bytes
+    return (unsigned) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < FLAT_HASH_GROUP_SIZE; i++) {
+        mask |= (unsigned) (group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+static inline unsigned flat_hash_match_empty(const signed char *group) {
+    return flat_hash_match_byte(group, FLAT_HASH_EMPTY);
+}
+
+static inline const void *flat_hash_slot_key(const void *key) {
+    return key;
+}
+
+template <typename K, typename V>
+static inline const void *flat_hash_slot_key(const std::pair<K, V> &slot) {
+    return slot.first;
+}
+
+// the storage shared by the set (Slot = K) and the map (Slot = std::pair<K, V>)
+template <typename K, typename Slot>
+class flat_pointer_table {
+public:
+    class iterator {
+    public:
+        iterator(const flat_pointer_table *table, size_t index) : table(table), index(index) { skip_free_slots(); }
+        Slot &operator*() const { return table->slots[index]; }
+        Slot *operator->() const { return &table->slots[index]; }
+        iterator &operator++() {
+            index++;
+            skip_free_slots();
+            return *this;
+        }
+        bool operator==(const iterator &other) const { return index == other.index; }
+        bool operator!=(const iterator &other) const { return index != other.index; }
+
+    private:
+        void skip_free_slots() {
+            while (index < table->capacity && table->control[index] < 0) index++;
+        }
+        const flat_pointer_table *table;
+        size_t index;
+    };
+
+    flat_pointer_table() : control(NULL), slots(NULL), capacity(0), number_of_elements(0), number_of_deleted(0), arena(current_function_arena) {}
+
+    flat_pointer_table(const flat_pointer_table &other)
+        : control(NULL), slots(NULL), capacity(0), number_of_elements(0), number_of_deleted(0), arena(other.arena) {
+        copy_from(other);
+    }
+
+    flat_pointer_table(flat_pointer_table &&other) noexcept
+        : control(other.control), slots(other.slots), capacity(other.capacity), number_of_elements(other.number_of_elements),
+          number_of_deleted(other.number_of_deleted), arena(other.arena) {
+        other.control = NULL;
+        other.slots = NULL;
+        other.capacity = other.number_of_elements = other.number_of_deleted = 0;
+    }
+
+    flat_pointer_table &operator=(const flat_pointer_table &other) {
+        if (this != &other) {
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    flat_pointer_table &operator=(flat_pointer_table &&other) noexcept {
+        if (this != &other && arena == other.arena) {
+            release();
+            std::swap(control, other.control);
+            std::swap(slots, other.slots);
+            std::swap(capacity, other.capacity);
+            std::swap(number_of_elements, other.number_of_elements);
+            std::swap(number_of_deleted, other.number_of_deleted);
+        } else if (this != &other) {
+            copy_from(other); // memory of another arena or of the heap cannot change owner
+        }
+        return *this;
+    }
+
+    ~flat_pointer_table() { release(); }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, capacity); }
+    size_t size() const { return number_of_elements; }
+    bool empty() const { return number_of_elements == 0; }
+    size_t count(K key) const { return find_index(key) != capacity; }
+    iterator find(K key) const { return iterator(this, find_index(key)); }
+
+    size_t erase(K key) {
+        size_t index = find_index(key);
+        if (index == capacity) {
+            return 0;
+        }
+        slots[index].~Slot();
+        // a probe stops at a group with an empty byte, so when the group already has one this slot
+        // can be empty again; otherwise it must stay a tombstone for the keys that probed past it
+        size_t group_start = index & ~(size_t) (FLAT_HASH_GROUP_SIZE - 1);
+        if (flat_hash_match_empty(control + group_start) != 0) {
+            control[index] = FLAT_HASH_EMPTY;
+        } else {
+            control[index] = FLAT_HASH_DELETED;
+            number_of_deleted++;
+        }
+        number_of_elements--;
+        return 1;
+    }
+
+    void clear() {
+        destroy_slots();
+        if (capacity != 0) {
+            memset(control, FLAT_HASH_EMPTY, capacity);
+        }
+        number_of_elements = number_of_deleted = 0;
+    }
+
+protected:
+    // index of the key's slot, capacity when it is absent
+    size_t find_index(K key) const {
+        if (capacity == 0) {
+            return capacity;
+        }
+        uint64_t hash = mix_pointer_hash(key);
+        signed char hash_byte = (signed char) (hash & 0x7f);
+        size_t group_mask = capacity / FLAT_HASH_GROUP_SIZE - 1;
+        size_t group = (size_t) (hash >> 7) & group_mask;
+        for (size_t step = 1;; step++) {
+            const signed char *group_control = control + group * FLAT_HASH_GROUP_SIZE;
+            for (unsigned match = flat_hash_match_byte(group_control, hash_byte); match != 0; match &= match - 1) {
+                size_t index = group * FLAT_HASH_GROUP_SIZE + __builtin_ctz(match);
+                if (flat_hash_slot_key(slots[index]) == (const void *) key) {
+                    return index;
+                }
+            }
+            if (flat_hash_match_empty(group_control) != 0) {
+                return capacity;
+            }
+            group = (group + step) & group_mask; // triangular steps visit every group
+        }
+    }
+
+    // slot where a key known to be absent goes, growing the table first when it is too full
+    size_t free_index_for(K key) {
+        if ((number_of_elements + number_of_deleted + 1) * 8 > capacity * 7) {
+            size_t new_capacity = capacity == 0 ? FLAT_HASH_MINIMUM_CAPACITY : capacity;
+            // the tombstones alone may have filled the table, then the same size is enough
+            while ((number_of_elements + 1) * 8 > new_capacity * 7 / 2) {
+                new_capacity *= 2;
+            }
+            rehash(new_capacity);
+        }
+        uint64_t hash = mix_pointer_hash(key);
+        size_t group_mask = capacity / FLAT_HASH_GROUP_SIZE - 1;
+        size_t group = (size_t) (hash >> 7) & group_mask;
+        for (size_t step = 1;; step++) {
+            unsigned free_slots = flat_hash_match_empty_or_deleted(control + group * FLAT_HASH_GROUP_SIZE);
+            if (free_slots != 0) {
+                size_t index = group * FLAT_HASH_GROUP_SIZE + __builtin_ctz(free_slots);
+                number_of_deleted -= control[index] == FLAT_HASH_DELETED;
+                control[index] = (signed char) (hash & 0x7f);
+                number_of_elements++;
+                return index;
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    signed char *control;
+    Slot *slots;
+    size_t capacity;
+    size_t number_of_elements;
+    size_t number_of_deleted;
+    function_arena *arena; // NULL when the table lives on the heap
+
+private:
+    static size_t bytes_for(size_t table_capacity) { return table_capacity + table_capacity * sizeof(Slot); }
+
+    void allocate(size_t table_capacity) {
+        size_t bytes = bytes_for(table_capacity);
+        char *memory = (char *) (arena != NULL ? arena->allocate(bytes) : ::operator new(bytes));
+        control = (signed char *) memory;
+        // the capacity is a multiple of 16, so the slots stay 16 byte aligned
+        slots = (Slot *) (memory + table_capacity);
+        capacity = table_capacity;
+        memset(control, FLAT_HASH_EMPTY, capacity);
+        number_of_elements = number_of_deleted = 0;
+    }
+
+    void destroy_slots() {
+        if (!std::is_trivially_destructible<Slot>::value) {
+            for (size_t i = 0; i < capacity; i++) {
+                if (control[i] >= 0) slots[i].~Slot();
+            }
+        }
+    }
+
+    void release() {
+        if (capacity == 0) {
+            return;
+        }
+        destroy_slots();
+        if (arena != NULL) {
+            arena->deallocate(control, bytes_for(capacity));
+        } else {
+            ::operator delete(control);
+        }
+        control = NULL;
+        slots = NULL;
+        capacity = number_of_elements = number_of_deleted = 0;
+    }
+
+    void rehash(size_t new_capacity) {
+        signed char *old_control = control;
+        Slot *old_slots = slots;
+        size_t old_capacity = capacity;
+        allocate(new_capacity);
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_control[i] >= 0) {
+                size_t index = free_index_for((K) flat_hash_slot_key(old_slots[i]));
+                new (&slots[index]) Slot(std::move(old_slots[i]));
+                old_slots[i].~Slot();
+            }
+        }
+        if (old_capacity != 0) {
+            if (arena != NULL) {
+                arena->deallocate(old_control, bytes_for(old_capacity));
+            } else {
+                ::operator delete(old_control);
+            }
+        }
+    }
+
+    void copy_from(const flat_pointer_table &other) {
+        if (capacity != other.capacity) {
+            release();
+            if (other.capacity != 0) allocate(other.capacity);
+        } else {
+            destroy_slots();
+        }
+        if (other.capacity == 0) {
+            return;
+        }
+        memcpy(control, other.control, capacity);
+        if (std::is_trivially_copyable<Slot>::value) {
+            memcpy((void *) slots, (const void *) other.slots, capacity * sizeof(Slot));
+        } else {
+            for (size_t i = 0; i < capacity; i++) {
+                if (control[i] >= 0) new (&slots[i]) Slot(other.slots[i]);
+            }
+        }
+        number_of_elements = other.number_of_elements;
+        number_of_deleted = other.number_of_deleted;
+    }
+};
+
+template <typename K>
+class flat_pointer_set : public flat_pointer_table<K, K> {
+public:
+    flat_pointer_set() {}
+    flat_pointer_set(std::initializer_list<K> keys) {
+        for (K key : keys) insert(key);
+    }
+
+    // true when the key was not there yet
+    bool insert(K key) {
+        if (this->find_index(key) != this->capacity) {
+            return false;
+        }
+        size_t index = this->free_index_for(key);
+        this->slots[index] = key;
+        return true;
+    }
+
+    template <typename Iterator>
+    void insert(Iterator first, Iterator last) {
+        for (; first != last; ++first) insert(*first);
+    }
+
+    bool operator==(const flat_pointer_set &other) const {
+        if (this->size() != other.size()) {
+            return false;
+        }
+        for (K key : *this) {
+            if (other.find_index(key) == other.capacity) return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const flat_pointer_set &other) const { return !(*this == other); }
+};
+
+template <typename K, typename V>
+class flat_pointer_map : public flat_pointer_table<K, std::pair<K, V>> {
+public:
+    // the value of the key, default constructed when the key is new
+    V &operator[](K key) {
+        size_t index = this->find_index(key);
+        if (index == this->capacity) {
+            index = this->free_index_for(key);
+            new (&this->slots[index]) std::pair<K, V>(key, V());
+        }
+        return this->slots[index].second;
+    }
+};
+
+// the containers every analysis in local_and_global.cpp keys on LLVM pointers
+template <typename T>
+using analysis_set = flat_pointer_set<T>;
+
+template <typename K, typename V>
+using analysis_map = flat_pointer_map<K, V>;
+
+#endif
@@ -0,0 +1,28 @@
+#include "function_analysis_manager.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(snapshots_built, "analysis_manager", "Number of function snapshots built");
+OPTIMIZER_STATISTIC(reaching_definitions_computed, "analysis_manager", "Number of times reaching definitions were computed");
+OPTIMIZER_STATISTIC(reaching_definitions_reused, "analysis_manager", "Number of times cached reaching definitions were reused");
+
+const struct function_snapshot &function_analysis_manager::get_snapshot() {
+    if ((valid_analyses & ANALYSIS_SNAPSHOT) == 0) {
+        build_function_snapshot(func, snapshot);
+        snapshots_built++;
+        valid_analyses |= ANALYSIS_SNAPSHOT;
+    }
+    return snapshot;
+}
+
+const struct reaching_definitions &function_analysis_manager::get_reaching_definitions() {
+    if ((valid_analyses & ANALYSIS_REACHING_DEFINITIONS) == 0) {
+        reaching = in_and_out_sets_map(get_snapshot(), &budget);
+        reaching_definitions_computed++;
+        if (reaching.is_complete) {
+            valid_analyses |= ANALYSIS_REACHING_DEFINITIONS;
+        }
+    } else {
+        reaching_definitions_reused++;
+    }
+    return reaching;
+}
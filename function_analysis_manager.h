@@ -0,0 +1,50 @@
+#ifndef FUNCTION_ANALYSIS_MANAGER_H
+#define FUNCTION_ANALYSIS_MANAGER_H
+
+#include <llvm-c/Core.h>
+#include "function_snapshot.h"
+#include "local_and_global.h"
+#include "compile_budget.h"
+
+// Cache of the analyses of one function, in the spirit of LLVM's FunctionAnalysisManager
+//
+// get_snapshot and get_reaching_definitions compute a result on first use and hand out the cached
+// one until it is invalidated. A pass that changed the function tells the manager what it
+// preserved and everything else is dropped. The snapshot (instruction index, store index and
+// predecessors) is stale after any change. Reaching definitions only depend on the stores and the
+// control flow graph: stores are numbered in layout order, so as long as no store, block or edge
+// was added, removed or moved, a new snapshot numbers stores and blocks the same way and the
+// cached IN and OUT sets still apply to it. None of the passes adds, removes or moves a store, a
+// block or an edge, which is what lets the global fixed point compute reaching definitions once
+// per function.
+//
+// The sets can still go stale in one direction. A store kills the others to the same pointer
+// value, and CSE can merge two equivalent pointers (GEPs with the same operands), after which a
+// store through one kills the stores through the other. Merging only adds kills, so the cached
+// sets are a superset of what a new computation would give. That is safe for load forwarding,
+// which needs every reaching store to the pointer to store the same constant: an extra store can
+// only make it give up.
+
+#define ANALYSIS_SNAPSHOT 1u
+#define ANALYSIS_REACHING_DEFINITIONS 2u
+#define ANALYSIS_NONE 0u
+#define ANALYSIS_ALL (ANALYSIS_SNAPSHOT | ANALYSIS_REACHING_DEFINITIONS)
+
+struct function_analysis_manager {
+    LLVMValueRef func;
+    unsigned valid_analyses = ANALYSIS_NONE;
+    struct function_snapshot snapshot;
+    struct reaching_definitions reaching;
+    struct compile_budget_tracker budget; // checked by the analyses and passes at round boundaries
+
+    explicit function_analysis_manager(LLVMValueRef function) : func(function) {}
+
+    const struct function_snapshot &get_snapshot();
+    // is_complete is false when the budget ran out before the fixed point, such a result is not cached
+    const struct reaching_definitions &get_reaching_definitions();
+
+    // called after a pass changed the function, with the analyses it preserved
+    void invalidate(unsigned preserved_analyses) { valid_analyses &= preserved_analyses; }
+};
+
+#endif
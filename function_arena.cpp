@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "function_arena.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(largest_function_arena_bytes, "function_arena", "Most bytes a single function took from its arena");
+
+thread_local function_arena *current_function_arena = NULL;
+
+// each thread optimizes one function at a time, so one arena per thread is enough
+static thread_local function_arena thread_arena;
+
+// only the bump position and the free list heads are cleared, the chunks stay allocated
+void function_arena::reset() {
+    current_chunk = 0;
+    used_in_current_chunk = 0;
+    bytes_taken = 0;
+    memset(free_lists, 0, sizeof(free_lists));
+}
+
+// moves to the next chunk big enough, allocating one twice the size of the last when none is
+void *function_arena::allocate_from_next_chunk(size_t rounded_size) {
+    size_t next_chunk = chunks.empty() ? 0 : current_chunk + 1;
+    while (next_chunk < chunks.size() && chunks[next_chunk].size < rounded_size) {
+        next_chunk++;
+    }
+    if (next_chunk == chunks.size()) {
+        size_t chunk_size = chunks.empty() ? FUNCTION_ARENA_FIRST_CHUNK_SIZE : chunks.back().size * 2;
+        while (chunk_size < rounded_size) {
+            chunk_size *= 2;
+        }
+        // malloc memory is aligned for any fundamental type, which covers FUNCTION_ARENA_ALIGNMENT
+        char *memory = (char *) malloc(chunk_size);
+        if (memory == NULL) {
+            throw std::bad_alloc();
+        }
+        chunks.push_back({memory, chunk_size});
+    }
+    current_chunk = next_chunk;
+    used_in_current_chunk = rounded_size;
+    bytes_taken += rounded_size;
+    return chunks[current_chunk].memory;
+}
+
+function_arena::~function_arena() {
+    for (chunk &owned_chunk : chunks) {
+        free(owned_chunk.memory);
+    }
+}
+
+function_arena_scope::function_arena_scope() : owns_the_arena(current_function_arena == NULL) {
+    if (owns_the_arena) {
+        current_function_arena = &thread_arena;
+    }
+}
+
+function_arena_scope::~function_arena_scope() {
+    if (owns_the_arena) {
+        largest_function_arena_bytes.record_maximum(thread_arena.bytes_taken);
+        thread_arena.reset();
+        current_function_arena = NULL;
+    }
+}
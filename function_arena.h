@@ -0,0 +1,99 @@
+#ifndef FUNCTION_ARENA_H
+#define FUNCTION_ARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+// Per function arena for the pointer keyed hash tables of the passes
+//
+// The pass sequence in optimizer.cpp opens a function_arena_scope. While it is open, every
+// analysis_set and analysis_map (flat_pointer_hash.h) created on the thread takes its tables from
+// the thread's arena: the block, instruction and pointer indices built with the snapshot and the
+// available loads of CSE. Freed blocks go to a free list of their size class and are reused, so a
+// table that grows does not grow the arena by every old size. Closing the scope resets the arena
+// in O(1), and its chunks are kept for the next function.
+//
+// The rest of the analysis data is not in the arena: the snapshot arrays, the GEN/KILL/IN/OUT
+// bit sets and the worklists are std::vector, and the expression and call tables of CSE are
+// std::unordered_map and std::map, all on the heap. A container created outside a scope also
+// allocates from the heap. Containers remember where their memory came from, so an arena-backed
+// container must not outlive its scope.
+
+#define FUNCTION_ARENA_FIRST_CHUNK_SIZE (64 * 1024)
+// blocks of up to 256 bytes are rounded to 16 bytes, bigger ones to a power of two
+#define FUNCTION_ARENA_SMALL_CLASSES 16
+#define FUNCTION_ARENA_SIZE_CLASSES 64
+#define FUNCTION_ARENA_ALIGNMENT 16
+
+struct function_arena {
+    struct chunk {
+        char *memory;
+        size_t size;
+    };
+    std::vector<chunk> chunks;
+    size_t current_chunk = 0;
+    size_t used_in_current_chunk = 0;
+    size_t bytes_taken = 0; // bumped since the last reset, freed blocks included
+    void *free_lists[FUNCTION_ARENA_SIZE_CLASSES] = {};
+
+    static size_t size_class(size_t size) {
+        if (size <= FUNCTION_ARENA_SMALL_CLASSES * 16) {
+            return size == 0 ? 0 : (size - 1) / 16;
+        }
+        size_t class_size = 512;
+        size_t size_class_index = FUNCTION_ARENA_SMALL_CLASSES;
+        while (class_size < size) {
+            class_size <<= 1;
+            size_class_index++;
+        }
+        return size_class_index;
+    }
+
+    static size_t class_size(size_t size_class_index) {
+        if (size_class_index < FUNCTION_ARENA_SMALL_CLASSES) {
+            return (size_class_index + 1) * 16;
+        }
+        return (size_t) 512 << (size_class_index - FUNCTION_ARENA_SMALL_CLASSES);
+    }
+
+    void *allocate(size_t size) {
+        size_t size_class_index = size_class(size);
+        void *block = free_lists[size_class_index];
+        if (block != NULL) {
+            free_lists[size_class_index] = *(void **) block;
+            return block;
+        }
+        size_t rounded_size = class_size(size_class_index);
+        if (current_chunk < chunks.size() && used_in_current_chunk + rounded_size <= chunks[current_chunk].size) {
+            block = chunks[current_chunk].memory + used_in_current_chunk;
+            used_in_current_chunk += rounded_size;
+            bytes_taken += rounded_size;
+            return block;
+        }
+        return allocate_from_next_chunk(rounded_size);
+    }
+
+    void deallocate(void *block, size_t size) {
+        size_t size_class_index = size_class(size);
+        *(void **) block = free_lists[size_class_index];
+        free_lists[size_class_index] = block;
+    }
+
+    void reset();
+    void *allocate_from_next_chunk(size_t rounded_size);
+    ~function_arena();
+};
+
+// the arena of the scope open on this thread, NULL outside the pass sequence
+extern thread_local function_arena *current_function_arena;
+
+// opens the thread's arena, a scope opened inside another one keeps using the outer arena
+struct function_arena_scope {
+    bool owns_the_arena;
+
+    function_arena_scope();
+    ~function_arena_scope();
+};
+
+#endif
@@ -0,0 +1,433 @@
+#include <llvm-c/Core.h>
+#include <llvm/Config/llvm-config.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "function_attributes.h"
+#include "function_cloning.h"
+#include "flat_pointer_hash.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(readnone_inferred, "function_attributes", "Number of functions found to access no memory");
+OPTIMIZER_STATISTIC(readonly_inferred, "function_attributes", "Number of functions found to only read memory");
+OPTIMIZER_STATISTIC(argmemonly_inferred, "function_attributes", "Number of functions found to only access memory their arguments point to");
+OPTIMIZER_STATISTIC(nounwind_inferred, "function_attributes", "Number of functions found to never unwind");
+OPTIMIZER_STATISTIC(willreturn_inferred, "function_attributes", "Number of functions found to always return");
+
+// the memory attribute of LLVM 16 to 20 holds two bits per location, Ref then Mod, for the
+// argument memory, the inaccessible memory and every other memory in that order. Inaccessible
+// memory is other memory here. Later releases add locations ahead of the other memory, so there
+// the attribute is neither read nor written: a call then may do anything, which is always right.
+#if LLVM_VERSION_MAJOR >= 16 && LLVM_VERSION_MAJOR <= 20
+#define MEMORY_ATTRIBUTE_LAYOUT_IS_KNOWN 1
+#else
+#define MEMORY_ATTRIBUTE_LAYOUT_IS_KNOWN 0
+#endif
+#define MEMORY_ATTRIBUTE_REF 1u
+#define MEMORY_ATTRIBUTE_MOD 2u
+#define MEMORY_ATTRIBUTE_ARGUMENT_SHIFT 0
+#define MEMORY_ATTRIBUTE_INACCESSIBLE_SHIFT 2
+#define MEMORY_ATTRIBUTE_OTHER_SHIFT 4
+
+// 0 for an attribute this version of LLVM does not have
+static unsigned attribute_kind(const char *name) {
+    return LLVMGetEnumAttributeKindForName(name, strlen(name));
+}
+
+// the attributes of one list, the call site's or the callee's, at the function index
+struct attribute_source {
+    LLVMValueRef call; // a call site when set
+    LLVMValueRef func; // else a function
+};
+
+static LLVMAttributeRef get_attribute(const struct attribute_source &source, unsigned kind) {
+    if (kind == 0) {
+        return NULL;
+    }
+    if (source.call != NULL) {
+        return LLVMGetCallSiteEnumAttribute(source.call, LLVMAttributeFunctionIndex, kind);
+    }
+    return LLVMGetEnumAttributeAtIndex(source.func, LLVMAttributeFunctionIndex, kind);
+}
+
+static bool has_attribute(const struct attribute_source &source, const char *name) {
+    return get_attribute(source, attribute_kind(name)) != NULL;
+}
+
+// leaves out of effects what the attributes of source rule out
+static void restrict_memory_effects(const struct attribute_source &source, struct memory_effects &effects) {
+    LLVMAttributeRef memory = get_attribute(source, attribute_kind("memory"));
+    if (memory != NULL && MEMORY_ATTRIBUTE_LAYOUT_IS_KNOWN) {
+        unsigned long long value = LLVMGetEnumAttributeValue(memory);
+        unsigned argument = (value >> MEMORY_ATTRIBUTE_ARGUMENT_SHIFT) & 3;
+        unsigned other = ((value >> MEMORY_ATTRIBUTE_INACCESSIBLE_SHIFT) | (value >> MEMORY_ATTRIBUTE_OTHER_SHIFT)) & 3;
+        effects.reads_argument_memory &= (argument & MEMORY_ATTRIBUTE_REF) != 0;
+        effects.writes_argument_memory &= (argument & MEMORY_ATTRIBUTE_MOD) != 0;
+        effects.reads_other_memory &= (other & MEMORY_ATTRIBUTE_REF) != 0;
+        effects.writes_other_memory &= (other & MEMORY_ATTRIBUTE_MOD) != 0;
+    }
+    if (has_attribute(source, "readnone")) {
+        effects = memory_effects();
+        return;
+    }
+    if (has_attribute(source, "readonly")) {
+        effects.writes_argument_memory = false;
+        effects.writes_other_memory = false;
+    }
+    if (has_attribute(source, "writeonly")) {
+        effects.reads_argument_memory = false;
+        effects.reads_other_memory = false;
+    }
+    if (has_attribute(source, "argmemonly")) {
+        effects.reads_other_memory = false;
+        effects.writes_other_memory = false;
+    }
+    if (has_attribute(source, "inaccessiblememonly")) {
+        effects.reads_argument_memory = false;
+        effects.writes_argument_memory = false;
+    }
+}
+
+// a call site attribute, or one of the function it calls directly
+static bool call_has_attribute(LLVMValueRef call, const char *name) {
+    struct attribute_source call_site = {call, NULL};
+    if (has_attribute(call_site, name)) {
+        return true;
+    }
+    LLVMValueRef callee = LLVMGetCalledValue(call);
+    struct attribute_source callee_source = {NULL, callee};
+    return LLVMIsAFunction(callee) != NULL && has_attribute(callee_source, name);
+}
+
+struct memory_effects memory_effects_of_call(LLVMValueRef call) {
+    struct memory_effects effects = {true, true, true, true};
+    struct attribute_source call_site = {call, NULL};
+    restrict_memory_effects(call_site, effects);
+    // through a pointer or inline assembly only the call site says anything
+    LLVMValueRef callee = LLVMGetCalledValue(call);
+    if (LLVMIsAFunction(callee) != NULL) {
+        struct attribute_source callee_source = {NULL, callee};
+        restrict_memory_effects(callee_source, effects);
+    }
+    return effects;
+}
+
+bool call_is_removable_if_unused(LLVMValueRef call) {
+    if (LLVMGetInstructionOpcode(call) != LLVMCall || is_debug_intrinsic(call)) {
+        return false;
+    }
+    return !memory_effects_of_call(call).writes() && call_has_attribute(call, "nounwind") && call_has_attribute(call, "willreturn");
+}
+
+bool call_is_pure(LLVMValueRef call) {
+    if (LLVMGetInstructionOpcode(call) != LLVMCall || LLVMIsAFunction(LLVMGetCalledValue(call)) == NULL || is_debug_intrinsic(call)) {
+        return false;
+    }
+    // a convergent call depends on which threads run it with it, not only on its operands
+    struct memory_effects effects = memory_effects_of_call(call);
+    return !effects.reads() && !effects.writes() && !call_has_attribute(call, "convergent");
+}
+
+bool is_unescaped_alloca(LLVMValueRef pointer) {
+    if (LLVMIsAAllocaInst(pointer) == NULL) {
+        return false;
+    }
+    for (LLVMUseRef use = LLVMGetFirstUse(pointer); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        LLVMOpcode opcode = LLVMIsAInstruction(user) != NULL ? LLVMGetInstructionOpcode(user) : LLVMRet;
+        if (opcode == LLVMLoad && !LLVMGetVolatile(user)) {
+            continue;
+        }
+        // as the pointer of a store, storing the pointer itself lets it escape
+        if (opcode == LLVMStore && !LLVMGetVolatile(user) && LLVMGetOperand(user, 1) == pointer && LLVMGetOperand(user, 0) != pointer) {
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+enum memory_location {
+    LOCAL_MEMORY,    // an alloca of the function, gone once it returns
+    ARGUMENT_MEMORY, // based on a parameter
+    OTHER_MEMORY
+};
+
+static enum memory_location location_of_pointer(LLVMValueRef pointer) {
+    while (true) {
+        LLVMOpcode opcode;
+        if (LLVMIsAInstruction(pointer) != NULL) {
+            opcode = LLVMGetInstructionOpcode(pointer);
+        } else if (LLVMIsAConstantExpr(pointer) != NULL) {
+            opcode = LLVMGetConstOpcode(pointer);
+        } else {
+            break;
+        }
+        if (opcode != LLVMGetElementPtr && opcode != LLVMBitCast && opcode != LLVMAddrSpaceCast) {
+            break;
+        }
+        pointer = LLVMGetOperand(pointer, 0);
+    }
+    if (LLVMIsAAllocaInst(pointer) != NULL) {
+        return LOCAL_MEMORY;
+    }
+    return LLVMIsAArgument(pointer) != NULL ? ARGUMENT_MEMORY : OTHER_MEMORY;
+}
+
+static void add_access(struct memory_effects &effects, enum memory_location location, bool reads, bool writes) {
+    if (location == ARGUMENT_MEMORY) {
+        effects.reads_argument_memory |= reads;
+        effects.writes_argument_memory |= writes;
+    } else if (location == OTHER_MEMORY) {
+        effects.reads_other_memory |= reads;
+        effects.writes_other_memory |= writes;
+    }
+}
+
+// true if a block of func branches back to one that is still on the depth first path
+static bool has_cycle(LLVMValueRef func) {
+    analysis_map<LLVMBasicBlockRef, unsigned char> state; // 1 on the path, 2 done
+    std::vector<std::pair<LLVMBasicBlockRef, unsigned>> path;
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(func);
+    state[entry] = 1;
+    path.push_back(std::make_pair(entry, 0u));
+    while (!path.empty()) {
+        LLVMBasicBlockRef bb = path.back().first;
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        unsigned next_successor = path.back().second++;
+        if (terminator == NULL || next_successor >= LLVMGetNumSuccessors(terminator)) {
+            state[bb] = 2;
+            path.pop_back();
+            continue;
+        }
+        LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, next_successor);
+        unsigned char &successor_state = state[successor];
+        if (successor_state == 1) {
+            return true;
+        }
+        if (successor_state == 0) {
+            successor_state = 1;
+            path.push_back(std::make_pair(successor, 0u));
+        }
+    }
+    return false;
+}
+
+// what the functions of one component do, together
+struct component_summary {
+    struct memory_effects effects;
+    bool is_nounwind = true;
+    bool will_return = true;
+    // a call inside the component passes it a pointer that is not an argument of the caller, so
+    // the argument memory of the component may be any memory
+    bool passes_other_memory_inside = false;
+};
+
+static void summarize_function(LLVMValueRef func, const struct call_graph &graph, unsigned scc, struct component_summary &summary) {
+    if (has_cycle(func)) {
+        summary.will_return = false;
+    }
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            LLVMOpcode opcode = LLVMGetInstructionOpcode(ins);
+            switch (opcode) {
+                case LLVMLoad:
+                case LLVMStore: {
+                    LLVMValueRef pointer = LLVMGetOperand(ins, opcode == LLVMLoad ? 0 : 1);
+                    if (LLVMGetVolatile(ins) || LLVMGetOrdering(ins) != LLVMAtomicOrderingNotAtomic) {
+                        add_access(summary.effects, OTHER_MEMORY, true, true); // seen by others or ordering theirs
+                    } else {
+                        add_access(summary.effects, location_of_pointer(pointer), opcode == LLVMLoad, opcode == LLVMStore);
+                    }
+                    break;
+                }
+                case LLVMAtomicRMW:
+                case LLVMAtomicCmpXchg:
+                case LLVMFence:
+                case LLVMVAArg:
+                    add_access(summary.effects, OTHER_MEMORY, true, true);
+                    break;
+                case LLVMResume:
+                case LLVMCleanupRet:
+                case LLVMCatchSwitch:
+                    summary.is_nounwind = false;
+                    break;
+                case LLVMCall:
+                case LLVMInvoke:
+                case LLVMCallBr: {
+                    if (opcode != LLVMCall) {
+                        summary.is_nounwind = false;
+                        summary.will_return = false;
+                    }
+                    if (is_debug_intrinsic(ins)) {
+                        break;
+                    }
+                    LLVMValueRef callee = called_function_with_body(ins);
+                    auto callee_index = callee == NULL ? graph.index_of.end() : graph.index_of.find(callee);
+                    if (callee_index != graph.index_of.end() && graph.scc_of[callee_index->second] == scc) {
+                        // what the component does is being summarized, only the pointers passed matter
+                        summary.will_return = false; // recursion
+                        for (unsigned i = 0; i < LLVMGetNumArgOperands(ins); i++) {
+                            LLVMValueRef argument = LLVMGetOperand(ins, i);
+                            if (LLVMGetTypeKind(LLVMTypeOf(argument)) == LLVMPointerTypeKind && location_of_pointer(argument) == OTHER_MEMORY) {
+                                summary.passes_other_memory_inside = true;
+                            }
+                        }
+                        break;
+                    }
+                    struct memory_effects effects = memory_effects_of_call(ins);
+                    add_access(summary.effects, OTHER_MEMORY, effects.reads_other_memory, effects.writes_other_memory);
+                    if (effects.reads_argument_memory || effects.writes_argument_memory) {
+                        // the argument memory of the callee is whatever the pointers passed to it are
+                        for (unsigned i = 0; i < LLVMGetNumArgOperands(ins); i++) {
+                            LLVMValueRef argument = LLVMGetOperand(ins, i);
+                            if (LLVMGetTypeKind(LLVMTypeOf(argument)) == LLVMPointerTypeKind) {
+                                add_access(summary.effects, location_of_pointer(argument), effects.reads_argument_memory, effects.writes_argument_memory);
+                            }
+                        }
+                    }
+                    summary.is_nounwind &= call_has_attribute(ins, "nounwind");
+                    summary.will_return &= call_has_attribute(ins, "willreturn");
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// adds the attribute unless func has it already, returns true if it was added
+static bool add_function_attribute(LLVMValueRef func, const char *name) {
+    struct attribute_source source = {NULL, func};
+    unsigned kind = attribute_kind(name);
+    if (kind == 0 || get_attribute(source, kind) != NULL) {
+        return false;
+    }
+    LLVMContextRef context = LLVMGetModuleContext(LLVMGetGlobalParent(func));
+    LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex, LLVMCreateEnumAttribute(context, kind, 0));
+    return true;
+}
+
+static void remove_function_attribute(LLVMValueRef func, const char *name) {
+    unsigned kind = attribute_kind(name);
+    if (kind != 0) {
+        LLVMRemoveEnumAttributeAtIndex(func, LLVMAttributeFunctionIndex, kind);
+    }
+}
+
+static unsigned encode_memory_attribute(const struct memory_effects &effects) {
+    unsigned argument = (effects.reads_argument_memory ? MEMORY_ATTRIBUTE_REF : 0) | (effects.writes_argument_memory ? MEMORY_ATTRIBUTE_MOD : 0);
+    unsigned other = (effects.reads_other_memory ? MEMORY_ATTRIBUTE_REF : 0) | (effects.writes_other_memory ? MEMORY_ATTRIBUTE_MOD : 0);
+    return argument << MEMORY_ATTRIBUTE_ARGUMENT_SHIFT | other << MEMORY_ATTRIBUTE_INACCESSIBLE_SHIFT | other << MEMORY_ATTRIBUTE_OTHER_SHIFT;
+}
+
+// the memory attribute of LLVM 16 to 20, or the attributes it replaced
+static unsigned add_memory_attributes(LLVMValueRef func, const struct memory_effects &effects) {
+    unsigned memory_kind = attribute_kind("memory");
+    if (memory_kind != 0 && !MEMORY_ATTRIBUTE_LAYOUT_IS_KNOWN) {
+        return 0;
+    }
+    if (memory_kind != 0) {
+        struct attribute_source source = {NULL, func};
+        LLVMAttributeRef existing = get_attribute(source, memory_kind);
+        unsigned long long existing_value = existing == NULL ? ~0ull : LLVMGetEnumAttributeValue(existing);
+        unsigned long long value = encode_memory_attribute(effects) & existing_value;
+        if (existing != NULL && value == existing_value) {
+            return 0;
+        }
+        LLVMContextRef context = LLVMGetModuleContext(LLVMGetGlobalParent(func));
+        LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex, LLVMCreateEnumAttribute(context, memory_kind, value));
+        if (!effects.reads() && !effects.writes()) {
+            readnone_inferred++;
+        } else if (!effects.writes()) {
+            readonly_inferred++;
+        } else if (!effects.reads_other_memory && !effects.writes_other_memory) {
+            argmemonly_inferred++;
+        }
+        return 1;
+    }
+
+    unsigned added = 0;
+    if (!effects.reads() && !effects.writes()) {
+        // the verifier rejects readnone next to any of these
+        remove_function_attribute(func, "readonly");
+        remove_function_attribute(func, "writeonly");
+        remove_function_attribute(func, "inaccessiblemem_or_argmemonly");
+        if (add_function_attribute(func, "readnone")) {
+            readnone_inferred++;
+            added++;
+        }
+        return added;
+    }
+    struct attribute_source source = {NULL, func};
+    if (!effects.writes() && !has_attribute(source, "readnone") && !has_attribute(source, "writeonly") &&
+        add_function_attribute(func, "readonly")) {
+        readonly_inferred++;
+        added++;
+    }
+    if (!effects.reads_other_memory && !effects.writes_other_memory && !has_attribute(source, "readnone") &&
+        !has_attribute(source, "inaccessiblememonly") && !has_attribute(source, "inaccessiblemem_or_argmemonly") &&
+        add_function_attribute(func, "argmemonly")) {
+        argmemonly_inferred++;
+        added++;
+    }
+    return added;
+}
+
+// a definition that may be replaced by another one at link time tells nothing about the one that runs
+static bool has_exact_definition(LLVMValueRef func) {
+    LLVMLinkage linkage = LLVMGetLinkage(func);
+    return LLVMCountBasicBlocks(func) != 0 &&
+           (linkage == LLVMExternalLinkage || linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage);
+}
+
+unsigned infer_function_attributes(const struct call_graph &graph, unsigned scc) {
+    scoped_pass_timer timer("infer_function_attributes");
+    struct component_summary summary;
+    for (unsigned function_index : graph.sccs[scc]) {
+        LLVMValueRef func = graph.functions[function_index];
+        if (!has_exact_definition(func)) {
+            return 0; // the rest of the component calls it, whatever it becomes
+        }
+        summarize_function(func, graph, scc, summary);
+    }
+    if (summary.passes_other_memory_inside) {
+        summary.effects.reads_other_memory |= summary.effects.reads_argument_memory;
+        summary.effects.writes_other_memory |= summary.effects.writes_argument_memory;
+    }
+
+    unsigned added = 0;
+    for (unsigned function_index : graph.sccs[scc]) {
+        LLVMValueRef func = graph.functions[function_index];
+        added += add_memory_attributes(func, summary.effects);
+        if (summary.is_nounwind && add_function_attribute(func, "nounwind")) {
+            nounwind_inferred++;
+            added++;
+        }
+        struct attribute_source source = {NULL, func};
+        if (summary.will_return && !has_attribute(source, "noreturn") && add_function_attribute(func, "willreturn")) {
+            willreturn_inferred++;
+            added++;
+        }
+    }
+    return added;
+}
+
+std::string call_effects_signature(LLVMValueRef func) {
+    std::string signature;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            if (LLVMIsACallInst(ins) == NULL) {
+                continue;
+            }
+            struct memory_effects effects = memory_effects_of_call(ins);
+            signature += (char) ('a' + (effects.reads_argument_memory | effects.writes_argument_memory << 1 |
+                                        effects.reads_other_memory << 2 | effects.writes_other_memory << 3));
+            signature += call_is_removable_if_unused(ins) ? 'r' : '-';
+            signature += call_is_pure(ins) ? 'p' : '-';
+        }
+    }
+    return signature;
+}
@@ -0,0 +1,51 @@
+#ifndef FUNCTION_ATTRIBUTES_H
+#define FUNCTION_ATTRIBUTES_H
+
+#include <llvm-c/Core.h>
+#include <string>
+#include "call_graph.h"
+
+// Memory effects of calls, and the function attributes that describe them
+//
+// The passes ask what a call may do through the attributes of the call and of the function it
+// calls: readnone, readonly, writeonly, argmemonly and inaccessiblememonly, or the memory
+// attribute that replaced them in LLVM 16 (only on 16 to 20, whose layout of it is known), plus
+// nounwind and willreturn. A call they say nothing about may read and write any memory, may
+// unwind and may not return.
+//
+// infer_function_attributes derives those attributes for the functions of one component of the
+// call graph from their bodies, once every component they call has its own. Memory of an alloca
+// of the function is not an effect, it is gone when the function returns. An access through a
+// pointer based on a parameter is argument memory, anything else is other memory. A component
+// with recursion or a loop is not known to return. Only definitions that are the ones that run
+// (external, internal, private) get attributes, and an attribute already there is kept.
+
+struct memory_effects {
+    bool reads_argument_memory = false;
+    bool writes_argument_memory = false;
+    bool reads_other_memory = false;
+    bool writes_other_memory = false;
+
+    bool reads() const { return reads_argument_memory || reads_other_memory; }
+    bool writes() const { return writes_argument_memory || writes_other_memory; }
+};
+
+// what the callee of call may do to memory, as its attributes tell
+struct memory_effects memory_effects_of_call(LLVMValueRef call);
+
+// a call whose result, if unused, can be erased: it writes no memory, cannot unwind and returns
+bool call_is_removable_if_unused(LLVMValueRef call);
+
+// a call to a function that reads no memory, two with the same operands give the same result
+bool call_is_pure(LLVMValueRef call);
+
+// an alloca whose address is only used to load from and store to it, which no call can reach
+bool is_unescaped_alloca(LLVMValueRef pointer);
+
+// adds the attributes of every function of graph.sccs[scc] and returns how many were added
+unsigned infer_function_attributes(const struct call_graph &graph, unsigned scc);
+
+// the effects of every call of func, in order, for keys of optimized bodies that depend on them
+std::string call_effects_signature(LLVMValueRef func);
+
+#endif
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <llvm-c/Core.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "optimizer.h"
+#include "function_cache.h"
+#include "function_transfer.h"
+#include "function_attributes.h"
+
+// On-disk layout (all integers in host byte order, records aligned to 8 bytes):
+//
+// header: magic[8] format_version(4) reserved(4) record_count(8) clock(8)
+// record: key_high(8) key_low(8) last_used(8) body_size(4) reserved(4) body[body_size] padding
+//
+// clock is a logical time increased on every hit or insertion, last_used stores the clock of
+// the latest use of the record and is what the LRU eviction sorts on.
+
+#define FUNCTION_CACHE_MAGIC "OPTFCACH"
+#define FUNCTION_CACHE_FORMAT_VERSION 1
+
+struct function_cache_file_header {
+    char magic[8];
+    unsigned int format_version;
+    unsigned int reserved;
+    unsigned long long record_count;
+    unsigned long long clock;
+};
+
+struct function_cache_record_header {
+    unsigned long long key_high;
+    unsigned long long key_low;
+    unsigned long long last_used;
+    unsigned int body_size;
+    unsigned int reserved;
+};
+
+struct key_hasher {
+    size_t operator()(const function_cache_key &key) const { return (size_t) key.low; }
+};
+
+struct key_equality {
+    bool operator()(const function_cache_key &a, const function_cache_key &b) const { return a.high == b.high && a.low == b.low; }
+};
+
+// a body added during this run, it only reaches the disk at function_cache_close
+struct new_cache_entry {
+    std::string body;
+    unsigned long long last_used;
+};
+
+struct function_cache {
+    std::mutex lock; // the server optimizes several modules at once
+    std::string path;
+    std::string pass_configuration;
+    unsigned long long size_limit_in_bytes;
+
+    int fd = -1;
+    char *mapping = NULL; // whole file, writable so that last_used is updated in place
+    size_t mapping_size = 0;
+    unsigned long long clock = 0;
+
+    // offset of each mapped record, and the bodies that only exist in memory
+    std::unordered_map<function_cache_key, size_t, key_hasher, key_equality> mapped_records;
+    std::unordered_map<function_cache_key, new_cache_entry, key_hasher, key_equality> new_entries;
+
+    unsigned long long lookups = 0;
+    unsigned long long hits = 0;
+    unsigned long long uncacheable_functions = 0;
+    unsigned long long failed_splices = 0;
+    unsigned long long insertions = 0;
+    unsigned long long evictions = 0;
+};
+
+static size_t record_size_on_disk(size_t body_size) {
+    return (sizeof(function_cache_record_header) + body_size + 7) & ~(size_t) 7;
+}
+
+// two independent 64 bit FNV-1a streams, each finished with the splitmix64 mixer
+static function_cache_key hash_text(const std::string &text) {
+    unsigned long long high = 0xcbf29ce484222325ull;
+    unsigned long long low = 0x84222325cbf29ce4ull;
+    for (unsigned char c : text) {
+        high = (high ^ c) * 0x100000001b3ull;
+        low = (low ^ c) * 0x00000100000001b3ull ^ (low >> 29);
+    }
+    unsigned long long mixed[2] = {high, low};
+    for (unsigned long long &value : mixed) {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ull;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebull;
+        value ^= value >> 31;
+    }
+    function_cache_key key = {mixed[0], mixed[1]};
+    return key;
+}
+
+struct function_cache *function_cache_open(const char *path, unsigned long long size_limit_in_bytes, const char *pass_configuration) {
+    struct function_cache *cache = new function_cache();
+    cache->path = path;
+    cache->pass_configuration = pass_configuration;
+    cache->size_limit_in_bytes = size_limit_in_bytes;
+
+    cache->fd = open(path, O_RDWR);
+    if (cache->fd < 0) { // no cache yet, it is created on close
+        return cache;
+    }
+    struct stat file_status;
+    if (fstat(cache->fd, &file_status) != 0 || (size_t) file_status.st_size < sizeof(function_cache_file_header)) {
+        close(cache->fd);
+        delete cache;
+        return NULL;
+    }
+    cache->mapping_size = file_status.st_size;
+    void *mapping = mmap(NULL, cache->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(cache->fd);
+        delete cache;
+        return NULL;
+    }
+    cache->mapping = (char *) mapping;
+
+    function_cache_file_header *header = (function_cache_file_header *) cache->mapping;
+    if (memcmp(header->magic, FUNCTION_CACHE_MAGIC, 8) != 0 || header->format_version != FUNCTION_CACHE_FORMAT_VERSION) {
+        munmap(cache->mapping, cache->mapping_size);
+        close(cache->fd);
+        delete cache;
+        return NULL;
+    }
+    cache->clock = header->clock;
+
+    // a truncated tail (e.g. from a crash) only loses the records it contains
+    size_t offset = sizeof(function_cache_file_header);
+    for (unsigned long long i = 0; i < header->record_count; i++) {
+        if (offset + sizeof(function_cache_record_header) > cache->mapping_size) {
+            break;
+        }
+        function_cache_record_header *record = (function_cache_record_header *) (cache->mapping + offset);
+        if (offset + record_size_on_disk(record->body_size) > cache->mapping_size) {
+            break;
+        }
+        function_cache_key key = {record->key_high, record->key_low};
+        cache->mapped_records[key] = offset;
+        offset += record_size_on_disk(record->body_size);
+    }
+    return cache;
+}
+
+bool function_cache_compute_key(struct function_cache *cache, LLVMValueRef func, struct function_cache_key *key) {
+    if (!function_body_is_transferable(func)) {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        cache->uncacheable_functions++;
+        return false;
+    }
+    char *printed_type = LLVMPrintTypeToString(LLVMGlobalGetValueType(func));
+    // what the passes may do around a call depends on the attributes of the callee, not in the body
+    std::string keyed_text = OPTIMIZER_VERSION "\n" + cache->pass_configuration + "\n" + printed_type + "\n" +
+                             call_effects_signature(func) + "\n" + print_function_body(func);
+    LLVMDisposeMessage(printed_type);
+    *key = hash_text(keyed_text);
+    return true;
+}
+
+bool function_cache_splice_if_present(struct function_cache *cache, struct function_cache_key key, LLVMValueRef func) {
+    std::string body; // copied out of the cache so the lock is not held while parsing
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        cache->lookups++;
+        auto new_entry = cache->new_entries.find(key);
+        auto mapped_record = cache->mapped_records.find(key);
+        if (new_entry != cache->new_entries.end()) {
+            new_entry->second.last_used = ++cache->clock;
+            body = new_entry->second.body;
+        } else if (mapped_record != cache->mapped_records.end()) {
+            function_cache_record_header *record = (function_cache_record_header *) (cache->mapping + mapped_record->second);
+            record->last_used = ++cache->clock;
+            body.assign((const char *) (record + 1), record->body_size);
+        } else {
+            return false;
+        }
+    }
+
+    bool spliced = splice_function_body(func, body.data(), body.size());
+    std::lock_guard<std::mutex> guard(cache->lock);
+    if (spliced) {
+        cache->hits++;
+    } else {
+        cache->failed_splices++;
+    }
+    return spliced;
+}
+
+void function_cache_insert(struct function_cache *cache, struct function_cache_key key, LLVMValueRef func) {
+    if (!function_body_is_transferable(func)) {
+        return;
+    }
+    std::string body = print_function_body(func);
+    std::lock_guard<std::mutex> guard(cache->lock);
+    if (cache->mapped_records.count(key) != 0 || cache->new_entries.count(key) != 0) {
+        return;
+    }
+    new_cache_entry entry;
+    entry.body = body;
+    entry.last_used = ++cache->clock;
+    cache->new_entries[key] = entry;
+    cache->insertions++;
+}
+
+// the surviving records are written to a temporary file that atomically replaces the cache
+static bool rewrite_cache_file(struct function_cache *cache) {
+    struct record_to_write {
+        function_cache_key key;
+        unsigned long long last_used;
+        const char *body;
+        size_t body_size;
+    };
+    std::vector<record_to_write> records;
+    for (auto &mapped_record : cache->mapped_records) {
+        function_cache_record_header *record = (function_cache_record_header *) (cache->mapping + mapped_record.second);
+        records.push_back({mapped_record.first, record->last_used, (const char *) (record + 1), record->body_size});
+    }
+    for (auto &new_entry : cache->new_entries) {
+        records.push_back({new_entry.first, new_entry.second.last_used, new_entry.second.body.data(), new_entry.second.body.size()});
+    }
+    // most recently used first, whatever does not fit in the size limit afterwards is evicted
+    std::sort(records.begin(), records.end(), [](const record_to_write &a, const record_to_write &b) { return a.last_used > b.last_used; });
+    size_t total_size = sizeof(function_cache_file_header);
+    size_t records_kept = 0;
+    while (records_kept < records.size() && total_size + record_size_on_disk(records[records_kept].body_size) <= cache->size_limit_in_bytes) {
+        total_size += record_size_on_disk(records[records_kept].body_size);
+        records_kept++;
+    }
+    cache->evictions += records.size() - records_kept;
+
+    std::string temporary_path = cache->path + ".tmp." + std::to_string(getpid());
+    FILE *output = fopen(temporary_path.c_str(), "wb");
+    if (output == NULL) {
+        return false;
+    }
+    function_cache_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FUNCTION_CACHE_MAGIC, 8);
+    header.format_version = FUNCTION_CACHE_FORMAT_VERSION;
+    header.record_count = records_kept;
+    header.clock = cache->clock;
+    bool write_failed = fwrite(&header, sizeof(header), 1, output) != 1;
+
+    static const char padding[8] = {0};
+    for (size_t i = 0; i < records_kept && !write_failed; i++) {
+        function_cache_record_header record;
+        memset(&record, 0, sizeof(record));
+        record.key_high = records[i].key.high;
+        record.key_low = records[i].key.low;
+        record.last_used = records[i].last_used;
+        record.body_size = (unsigned int) records[i].body_size;
+        size_t padding_size = record_size_on_disk(records[i].body_size) - sizeof(record) - records[i].body_size;
+        write_failed = fwrite(&record, sizeof(record), 1, output) != 1 ||
+                       fwrite(records[i].body, 1, records[i].body_size, output) != records[i].body_size ||
+                       fwrite(padding, 1, padding_size, output) != padding_size;
+    }
+    if (fclose(output) != 0 || write_failed) {
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    if (rename(temporary_path.c_str(), cache->path.c_str()) != 0) {
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void function_cache_close(struct function_cache *cache) {
+    if (!cache->new_entries.empty() && !rewrite_cache_file(cache)) {
+        fprintf(stderr, "Could not write the function cache %s\n", cache->path.c_str());
+    } else if (cache->mapping != NULL) {
+        // only last_used changed, it is already in the mapped file
+        ((function_cache_file_header *) cache->mapping)->clock = cache->clock;
+    }
+    if (cache->mapping != NULL) {
+        munmap(cache->mapping, cache->mapping_size);
+    }
+    if (cache->fd >= 0) {
+        close(cache->fd);
+    }
+    delete cache;
+}
+
+void function_cache_print_statistics(struct function_cache *cache, FILE *output) {
+    std::lock_guard<std::mutex> guard(cache->lock);
+    double hit_rate = cache->lookups == 0 ? 0 : 100.0 * cache->hits / cache->lookups;
+    fprintf(output, "function cache: %llu lookups, %llu hits (%.1f%%), %llu failed splices, %llu uncacheable functions, %llu insertions, %llu evictions\n",
+            cache->lookups, cache->hits, hit_rate, cache->failed_splices, cache->uncacheable_functions, cache->insertions, cache->evictions);
+}
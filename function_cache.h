@@ -0,0 +1,38 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+
+// Content addressed on-disk cache of optimized function bodies
+//
+// The key is a 128 bit hash of the function's printed type and body, the optimizer version and the
+// pass configuration. The value is the printed body after optimization. The file is memory-mapped,
+// lookups never copy the stored body, and when new bodies are added the file is rewritten keeping
+// the most recently used entries that fit in the size limit.
+
+#define FUNCTION_CACHE_DEFAULT_SIZE_LIMIT (64ull << 20) // bytes
+
+struct function_cache;
+
+struct function_cache_key {
+    unsigned long long high;
+    unsigned long long low;
+};
+
+// a missing file is treated as an empty cache, NULL is returned only if the file exists but is unusable
+struct function_cache *function_cache_open(const char *path, unsigned long long size_limit_in_bytes, const char *pass_configuration);
+// writes the new entries back (evicting the least recently used ones) and releases the cache
+void function_cache_close(struct function_cache *cache);
+
+// false when the function cannot go through the cache (e.g. it carries metadata other than on terminators)
+bool function_cache_compute_key(struct function_cache *cache, LLVMValueRef func, struct function_cache_key *key);
+// replaces the body of func with the cached optimized body, false on a miss or if splicing failed
+bool function_cache_splice_if_present(struct function_cache *cache, struct function_cache_key key, LLVMValueRef func);
+// records the body of func, which has just been optimized, under key
+void function_cache_insert(struct function_cache *cache, struct function_cache_key key, LLVMValueRef func);
+
+void function_cache_print_statistics(struct function_cache *cache, FILE *output);
+
+#endif
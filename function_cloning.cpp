@@ -0,0 +1,114 @@
+#include <string.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <utility>
+#include "function_cloning.h"
+
+bool is_debug_intrinsic(LLVMValueRef ins) {
+    if (LLVMIsACallInst(ins) == NULL) {
+        return false;
+    }
+    LLVMValueRef called = LLVMGetCalledValue(ins);
+    if (LLVMIsAFunction(called) == NULL) {
+        return false;
+    }
+    size_t name_length;
+    const char *name = LLVMGetValueName2(called, &name_length);
+    return name_length > 9 && strncmp(name, "llvm.dbg.", 9) == 0;
+}
+
+unsigned long long count_body_instructions(LLVMValueRef func) {
+    unsigned long long instructions = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            instructions += !is_debug_intrinsic(ins);
+        }
+    }
+    return instructions;
+}
+
+bool parameter_is_passed_by_copy(LLVMValueRef func, unsigned index) {
+    static const char *const copying_attributes[] = {"byval", "inalloca", "preallocated"};
+    for (const char *name : copying_attributes) {
+        unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+        if (kind != 0 && LLVMGetEnumAttributeAtIndex(func, index + 1, kind) != NULL) { // attribute index 0 is the return value
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string value_name(LLVMValueRef value) {
+    size_t name_length;
+    const char *name = LLVMGetValueName2(value, &name_length);
+    return std::string(name, name_length);
+}
+
+static LLVMValueRef copied_value(const struct function_body_copy &copy, LLVMValueRef value) {
+    auto mapped = copy.copy_of.find(value);
+    return mapped != copy.copy_of.end() ? mapped->second : value;
+}
+
+LLVMBasicBlockRef copy_function_body(LLVMValueRef source, LLVMValueRef destination, LLVMBasicBlockRef insert_before,
+                                     struct function_body_copy &copy) {
+    LLVMContextRef context = LLVMGetTypeContext(LLVMTypeOf(source));
+    LLVMBasicBlockRef source_entry = LLVMGetEntryBasicBlock(source);
+    for (LLVMBasicBlockRef bb = source_entry; bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        const char *name = LLVMGetBasicBlockName(bb);
+        LLVMBasicBlockRef block = insert_before != NULL ? LLVMInsertBasicBlockInContext(context, insert_before, name)
+                                                        : LLVMAppendBasicBlockInContext(context, destination, name);
+        copy.copy_of[LLVMBasicBlockAsValue(bb)] = LLVMBasicBlockAsValue(block);
+    }
+
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+    std::vector<LLVMValueRef> copies;
+    std::vector<std::pair<LLVMValueRef, LLVMValueRef>> phis; // source phi and its copy
+    for (LLVMBasicBlockRef bb = source_entry; bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMPositionBuilderAtEnd(builder, LLVMValueAsBasicBlock(copy.copy_of[LLVMBasicBlockAsValue(bb)]));
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            if (is_debug_intrinsic(ins)) continue;
+            LLVMOpcode opcode = LLVMGetInstructionOpcode(ins);
+            LLVMValueRef instruction_copy;
+            if (opcode == LLVMRet && copy.return_block != NULL) {
+                if (LLVMGetNumOperands(ins) != 0) {
+                    copy.returned_values.push_back(LLVMGetOperand(ins, 0));
+                    copy.returning_blocks.push_back(LLVMGetInsertBlock(builder));
+                }
+                instruction_copy = LLVMBuildBr(builder, copy.return_block);
+            } else if (opcode == LLVMPHI) {
+                instruction_copy = LLVMBuildPhi(builder, LLVMTypeOf(ins), value_name(ins).c_str());
+                phis.push_back(std::make_pair(ins, instruction_copy));
+            } else {
+                instruction_copy = LLVMInstructionClone(ins);
+                bool is_moved = opcode == LLVMAlloca && copy.alloca_builder != NULL;
+                LLVMInsertIntoBuilderWithName(is_moved ? copy.alloca_builder : builder, instruction_copy, value_name(ins).c_str());
+                copies.push_back(instruction_copy);
+            }
+            LLVMInstructionSetDebugLoc(instruction_copy, copy.location);
+            copy.copy_of[ins] = instruction_copy;
+        }
+    }
+    LLVMDisposeBuilder(builder);
+
+    for (LLVMValueRef instruction_copy : copies) {
+        int number_of_operands = LLVMGetNumOperands(instruction_copy);
+        for (int i = 0; i < number_of_operands; i++) {
+            LLVMValueRef operand = LLVMGetOperand(instruction_copy, i);
+            LLVMValueRef mapped = copied_value(copy, operand);
+            if (mapped != operand) {
+                LLVMSetOperand(instruction_copy, i, mapped);
+            }
+        }
+    }
+    for (std::pair<LLVMValueRef, LLVMValueRef> &phi : phis) {
+        for (unsigned i = 0; i < LLVMCountIncoming(phi.first); i++) {
+            LLVMValueRef value = copied_value(copy, LLVMGetIncomingValue(phi.first, i));
+            LLVMBasicBlockRef block = LLVMValueAsBasicBlock(copy.copy_of[LLVMBasicBlockAsValue(LLVMGetIncomingBlock(phi.first, i))]);
+            LLVMAddIncoming(phi.second, &value, &block, 1);
+        }
+    }
+    for (LLVMValueRef &returned : copy.returned_values) {
+        returned = copied_value(copy, returned);
+    }
+    return LLVMValueAsBasicBlock(copy.copy_of[LLVMBasicBlockAsValue(source_entry)]);
+}
@@ -0,0 +1,43 @@
+#ifndef FUNCTION_CLONING_H
+#define FUNCTION_CLONING_H
+
+#include <llvm-c/Core.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Copying the body of a function into another one, for the inliner and the specialization
+//
+// The blocks of the source are created in the destination and every instruction is copied, then
+// the operands of the copies are rewritten through copy_of once everything exists, since a loop
+// uses values defined further down. Phis are rebuilt instead of copied, the C API cannot change
+// the incoming block of a phi. Debug intrinsics are dropped and every copy gets location: the
+// locations of the source belong to its own subprogram.
+
+struct function_body_copy {
+    std::unordered_map<LLVMValueRef, LLVMValueRef> copy_of; // the parameters of the source are filled in by the caller
+    LLVMBasicBlockRef return_block = NULL; // when set, returns become branches to it
+    LLVMBuilderRef alloca_builder = NULL;  // when set, the allocas are placed with it instead of in their block
+    LLVMMetadataRef location = NULL;
+    std::vector<LLVMValueRef> returned_values;      // the copied values, filled when return_block is set
+    std::vector<LLVMBasicBlockRef> returning_blocks;
+};
+
+// the copied blocks go before insert_before, or at the end of destination when it is NULL.
+// Returns the copy of the entry block.
+LLVMBasicBlockRef copy_function_body(LLVMValueRef source, LLVMValueRef destination, LLVMBasicBlockRef insert_before,
+                                     struct function_body_copy &copy);
+
+// llvm.dbg.value and llvm.dbg.declare, which describe variables of their function's scope
+bool is_debug_intrinsic(LLVMValueRef ins);
+
+// instructions other than debug intrinsics, what the inliner and the specialization cost by
+unsigned long long count_body_instructions(LLVMValueRef func);
+
+// a byval, inalloca or preallocated parameter, which points to a copy the call makes of what
+// the argument points to, so the argument itself never reaches the body
+bool parameter_is_passed_by_copy(LLVMValueRef func, unsigned index);
+
+std::string value_name(LLVMValueRef value);
+
+#endif
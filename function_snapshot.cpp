@@ -0,0 +1,124 @@
+#include <llvm-c/Core.h>
+#include <vector>
+#include "function_snapshot.h"
+#include "function_attributes.h"
+#include "flat_pointer_hash.h"
+#include "pass_timing.h"
+
+// turns per row counts into compressed row starts and returns the total
+static unsigned counts_to_starts(std::vector<unsigned> &starts) {
+    unsigned total = 0;
+    for (unsigned &start : starts) {
+        unsigned count = start;
+        start = total;
+        total += count;
+    }
+    return total;
+}
+
+void build_function_snapshot(LLVMValueRef func, struct function_snapshot &snapshot) {
+    scoped_pass_timer timer("build_function_snapshot");
+    snapshot = function_snapshot();
+    analysis_map<LLVMBasicBlockRef, unsigned> block_index;
+    analysis_map<LLVMValueRef, unsigned> instruction_index;
+    analysis_map<LLVMValueRef, unsigned> pointer_index;
+    std::vector<LLVMValueRef> stored_values; // resolved once every instruction has its index
+    bool has_writing_call = false;
+
+    // one walk over the IR fills the per instruction columns
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        unsigned block = (unsigned) snapshot.blocks.size();
+        block_index[bb] = block;
+        snapshot.blocks.push_back(bb);
+        snapshot.block_start.push_back((unsigned) snapshot.instructions.size());
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            unsigned instruction = (unsigned) snapshot.instructions.size();
+            LLVMOpcode opcode = LLVMGetInstructionOpcode(ins);
+            instruction_index[ins] = instruction;
+            snapshot.instructions.push_back(ins);
+            snapshot.opcodes.push_back(opcode);
+            snapshot.block_of_instruction.push_back(block);
+            snapshot.store_number.push_back(SNAPSHOT_NO_INDEX);
+            snapshot.memory_pointer.push_back(SNAPSHOT_NO_INDEX);
+            if (opcode == LLVMCall || opcode == LLVMInvoke || opcode == LLVMCallBr) {
+                has_writing_call = has_writing_call || memory_effects_of_call(ins).writes();
+            }
+            if (opcode != LLVMLoad && opcode != LLVMStore) {
+                continue;
+            }
+            LLVMValueRef pointer = LLVMGetOperand(ins, opcode == LLVMLoad ? 0 : 1);
+            auto known_pointer = pointer_index.find(pointer);
+            unsigned pointer_number;
+            if (known_pointer == pointer_index.end()) {
+                pointer_number = (unsigned) snapshot.pointers.size();
+                pointer_index[pointer] = pointer_number;
+                snapshot.pointers.push_back(pointer);
+            } else {
+                pointer_number = known_pointer->second;
+            }
+            snapshot.memory_pointer[instruction] = pointer_number;
+            if (opcode == LLVMStore) {
+                LLVMValueRef value = LLVMGetOperand(ins, 0);
+                snapshot.store_number[instruction] = snapshot.number_of_stores();
+                snapshot.store_instruction.push_back(instruction);
+                bool is_constant_int = LLVMIsAConstantInt(value) != NULL;
+                snapshot.stored_value_is_constant_int.push_back(is_constant_int);
+                snapshot.stored_constant.push_back(is_constant_int ? LLVMConstIntGetSExtValue(value) : 0);
+                stored_values.push_back(value);
+            }
+        }
+    }
+    unsigned number_of_blocks = snapshot.number_of_blocks();
+    unsigned number_of_stores = snapshot.number_of_stores();
+    snapshot.block_start.push_back((unsigned) snapshot.instructions.size());
+    for (LLVMValueRef value : stored_values) {
+        auto value_instruction = instruction_index.find(value);
+        snapshot.stored_value_instruction.push_back(value_instruction == instruction_index.end() ? SNAPSHOT_NO_INDEX : value_instruction->second);
+    }
+
+    // a call that may write memory may write any pointer it can reach, which excludes only the
+    // allocas whose address never leaves the loads and stores
+    for (LLVMValueRef pointer : snapshot.pointers) {
+        snapshot.pointer_may_be_written_by_call.push_back(has_writing_call && !is_unescaped_alloca(pointer));
+    }
+
+    // stores grouped by pointer, kept in layout order, with links to the neighbours of each store
+    snapshot.pointer_store_start.assign(snapshot.pointers.size() + 1, 0);
+    for (unsigned store = 0; store < number_of_stores; store++) {
+        snapshot.pointer_store_start[snapshot.memory_pointer[snapshot.store_instruction[store]]]++;
+    }
+    snapshot.pointer_stores.resize(counts_to_starts(snapshot.pointer_store_start));
+    std::vector<unsigned> filled(snapshot.pointer_store_start.begin(), snapshot.pointer_store_start.end() - 1);
+    snapshot.previous_store_to_same_pointer.assign(number_of_stores, SNAPSHOT_NO_INDEX);
+    snapshot.next_store_to_same_pointer.assign(number_of_stores, SNAPSHOT_NO_INDEX);
+    for (unsigned store = 0; store < number_of_stores; store++) {
+        unsigned pointer = snapshot.memory_pointer[snapshot.store_instruction[store]];
+        if (filled[pointer] != snapshot.pointer_store_start[pointer]) {
+            unsigned previous = snapshot.pointer_stores[filled[pointer] - 1];
+            snapshot.previous_store_to_same_pointer[store] = previous;
+            snapshot.next_store_to_same_pointer[previous] = store;
+        }
+        snapshot.pointer_stores[filled[pointer]++] = store;
+    }
+
+    // successors from the terminators, predecessors by inverting them
+    snapshot.successor_start.push_back(0);
+    snapshot.predecessor_start.assign(number_of_blocks + 1, 0);
+    for (unsigned block = 0; block < number_of_blocks; block++) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(snapshot.blocks[block]);
+        unsigned number_of_successors = terminator == NULL ? 0 : LLVMGetNumSuccessors(terminator);
+        for (unsigned i = 0; i < number_of_successors; i++) {
+            unsigned successor = block_index[LLVMGetSuccessor(terminator, i)];
+            snapshot.successors.push_back(successor);
+            snapshot.predecessor_start[successor]++;
+        }
+        snapshot.successor_start.push_back((unsigned) snapshot.successors.size());
+    }
+    snapshot.predecessors.resize(counts_to_starts(snapshot.predecessor_start));
+    filled.assign(snapshot.predecessor_start.begin(), snapshot.predecessor_start.end() - 1);
+    for (unsigned block = 0; block < number_of_blocks; block++) {
+        for (unsigned edge = snapshot.successor_start[block]; edge < snapshot.successor_start[block + 1]; edge++) {
+            snapshot.predecessors[filled[snapshot.successors[edge]]++] = block;
+        }
+    }
+}
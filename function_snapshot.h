@@ -0,0 +1,77 @@
+#ifndef FUNCTION_SNAPSHOT_H
+#define FUNCTION_SNAPSHOT_H
+
+#include <stdint.h>
+#include <llvm-c/Core.h>
+#include <vector>
+
+// Dense, column oriented copy of what the reaching definitions analyses read from a function
+//
+// build_function_snapshot walks the function once through the C API. Blocks, instructions,
+// stores and the pointers loads and stores access get dense indices, and every property the
+// analyses need is a vector indexed by one of them. The lists (instructions of a block, stores
+// to a pointer, successors and predecessors) are compressed rows: the entries of row r are
+// [start[r], start[r + 1]) of one contiguous vector. The snapshot is read only. A pass that
+// changes the IR writes the change through the C API and builds a new snapshot on its next round.
+//
+// Only the operands the analyses use are columns (the pointer of loads and stores and the stored
+// value); a general operand table would cost a C API call per operand for nothing.
+
+#define SNAPSHOT_NO_INDEX UINT32_MAX
+
+struct function_snapshot {
+    // blocks in layout order, the instructions of block b are [block_start[b], block_start[b + 1])
+    std::vector<LLVMBasicBlockRef> blocks;
+    std::vector<unsigned> block_start;
+
+    // one entry per instruction
+    std::vector<LLVMValueRef> instructions;
+    std::vector<LLVMOpcode> opcodes;
+    std::vector<unsigned> block_of_instruction;
+    std::vector<unsigned> memory_pointer; // dense pointer number for loads and stores
+    std::vector<unsigned> store_number;   // dense store number for stores
+
+    // one entry per distinct pointer loaded from or stored to
+    std::vector<LLVMValueRef> pointers;
+    std::vector<unsigned> pointer_store_start; // stores to pointer p, in layout order
+    std::vector<unsigned> pointer_stores;
+    std::vector<unsigned char> pointer_may_be_written_by_call; // see function_attributes.h
+
+    // one entry per store, stores are numbered in layout order
+    std::vector<unsigned> store_instruction;
+    std::vector<unsigned> previous_store_to_same_pointer;
+    std::vector<unsigned> next_store_to_same_pointer;
+    std::vector<unsigned char> stored_value_is_constant_int;
+    std::vector<long long> stored_constant;             // sign extended, when the value is a ConstantInt
+    std::vector<unsigned> stored_value_instruction;     // when the value is an instruction of the function
+
+    // control flow graph, duplicate edges (a switch with two cases to one block) appear once per case
+    std::vector<unsigned> successor_start;
+    std::vector<unsigned> successors;
+    std::vector<unsigned> predecessor_start;
+    std::vector<unsigned> predecessors;
+
+    unsigned number_of_blocks() const { return (unsigned) blocks.size(); }
+    unsigned number_of_stores() const { return (unsigned) store_instruction.size(); }
+};
+
+void build_function_snapshot(LLVMValueRef func, struct function_snapshot &snapshot);
+
+// sets of stores as bit vectors of store numbers, words_for_bits(number_of_stores()) words each
+static inline unsigned words_for_bits(unsigned bits) {
+    return (bits + 63) / 64;
+}
+
+static inline void set_bit(uint64_t *bits, unsigned index) {
+    bits[index / 64] |= 1ull << (index % 64);
+}
+
+static inline void clear_bit(uint64_t *bits, unsigned index) {
+    bits[index / 64] &= ~(1ull << (index % 64));
+}
+
+static inline bool test_bit(const uint64_t *bits, unsigned index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+#endif
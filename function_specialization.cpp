@@ -0,0 +1,152 @@
+#include <llvm-c/Core.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "function_specialization.h"
+#include "function_cloning.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(specializations_created, "specialization", "Number of function copies made for constant arguments");
+OPTIMIZER_STATISTIC(calls_specialized, "specialization", "Number of calls pointed at a specialized copy");
+OPTIMIZER_STATISTIC(specializations_over_budget, "specialization", "Number of candidate copies left out by the code growth budget");
+
+// the constant arguments one or more calls pass, NULL for a parameter that is not constant
+struct specialization_candidate {
+    std::vector<LLVMValueRef> constants;
+    std::vector<LLVMValueRef> calls;
+};
+
+static bool is_exact_definition(LLVMValueRef func) {
+    LLVMLinkage linkage = LLVMGetLinkage(func);
+    return linkage == LLVMExternalLinkage || linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage;
+}
+
+// a body copy_function_body can duplicate: no exception handling, and no block address that
+// would still point into the original
+static bool can_be_copied(LLVMValueRef func) {
+    if (LLVMIsFunctionVarArg(LLVMGlobalGetValueType(func)) || LLVMHasPersonalityFn(func)) {
+        return false;
+    }
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMOpcode opcode = LLVMGetInstructionOpcode(LLVMGetBasicBlockTerminator(bb));
+        if (opcode == LLVMIndirectBr || opcode == LLVMCallBr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// groups the direct calls of func by the constants they pass. Returns false if func is used
+// other than by a call that is in a candidate.
+static bool collect_candidates(LLVMValueRef func, std::vector<struct specialization_candidate> &candidates) {
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(func);
+    unsigned number_of_params = LLVMCountParams(func);
+    bool are_all_uses_candidates = true;
+    for (LLVMUseRef use = LLVMGetFirstUse(func); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef call = LLVMGetUser(use);
+        if (LLVMIsACallInst(call) == NULL || LLVMGetCalledValue(call) != func || LLVMGetCalledFunctionType(call) != function_type ||
+            (unsigned) LLVMGetNumOperands(call) != number_of_params + 1) {
+            are_all_uses_candidates = false;
+            continue;
+        }
+        std::vector<LLVMValueRef> constants(number_of_params, NULL);
+        bool fixes_a_used_param = false;
+        for (unsigned i = 0; i < number_of_params; i++) {
+            LLVMValueRef argument = LLVMGetOperand(call, i);
+            // a byval argument is copied by the call, the body never sees the constant pointer
+            if (LLVMIsConstant(argument) && !LLVMIsUndef(argument) && !parameter_is_passed_by_copy(func, i)) {
+                constants[i] = argument;
+                fixes_a_used_param |= LLVMGetFirstUse(LLVMGetParam(func, i)) != NULL;
+            }
+        }
+        if (!fixes_a_used_param) {
+            are_all_uses_candidates = false;
+            continue;
+        }
+        auto same_constants = std::find_if(candidates.begin(), candidates.end(),
+                                           [&](const struct specialization_candidate &candidate) { return candidate.constants == constants; });
+        if (same_constants == candidates.end()) {
+            candidates.push_back(specialization_candidate());
+            same_constants = candidates.end() - 1;
+            same_constants->constants = constants;
+        }
+        same_constants->calls.push_back(call);
+    }
+    return are_all_uses_candidates;
+}
+
+static void copy_attributes(LLVMValueRef from, LLVMValueRef to, LLVMAttributeIndex index) {
+    unsigned count = LLVMGetAttributeCountAtIndex(from, index);
+    std::vector<LLVMAttributeRef> attributes(count);
+    LLVMGetAttributesAtIndex(from, index, attributes.data());
+    for (LLVMAttributeRef attribute : attributes) {
+        LLVMAddAttributeAtIndex(to, index, attribute);
+    }
+}
+
+static LLVMValueRef create_specialization(LLVMValueRef func, const std::vector<LLVMValueRef> &constants, unsigned number) {
+    std::string name = value_name(func) + ".specialized." + std::to_string(number);
+    LLVMValueRef specialization = LLVMAddFunction(LLVMGetGlobalParent(func), name.c_str(), LLVMGlobalGetValueType(func));
+    LLVMSetLinkage(specialization, LLVMInternalLinkage);
+    LLVMSetFunctionCallConv(specialization, LLVMGetFunctionCallConv(func));
+    if (LLVMGetSection(func) != NULL) {
+        LLVMSetSection(specialization, LLVMGetSection(func));
+    }
+    LLVMSetAlignment(specialization, LLVMGetAlignment(func));
+    copy_attributes(func, specialization, LLVMAttributeFunctionIndex);
+    copy_attributes(func, specialization, LLVMAttributeReturnIndex);
+    struct function_body_copy copy;
+    for (unsigned i = 0; i < LLVMCountParams(func); i++) {
+        copy_attributes(func, specialization, i + 1);
+        LLVMValueRef param = LLVMGetParam(specialization, i);
+        std::string param_name = value_name(LLVMGetParam(func, i));
+        LLVMSetValueName2(param, param_name.c_str(), param_name.size());
+        copy.copy_of[LLVMGetParam(func, i)] = constants[i] != NULL ? constants[i] : param;
+    }
+    // the copy has no subprogram of its own, so it carries no debug locations
+    copy_function_body(func, specialization, NULL, copy);
+    return specialization;
+}
+
+std::vector<LLVMValueRef> specialize_functions(LLVMModuleRef module, unsigned long long budget, bool constants_are_propagated) {
+    scoped_pass_timer timer("function_specialization");
+    std::vector<LLVMValueRef> originals; // the copies are added to the module while it is walked
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (LLVMCountBasicBlocks(func) != 0 && is_exact_definition(func) && can_be_copied(func)) {
+            originals.push_back(func);
+        }
+    }
+    std::vector<LLVMValueRef> specializations;
+    unsigned long long instructions_added = 0;
+    for (LLVMValueRef func : originals) {
+        std::vector<struct specialization_candidate> candidates;
+        bool are_all_uses_candidates = collect_candidates(func, candidates);
+        LLVMLinkage linkage = LLVMGetLinkage(func);
+        if (candidates.empty() || (constants_are_propagated && are_all_uses_candidates && candidates.size() == 1 &&
+                                   (linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage))) {
+            continue;
+        }
+        // the constants passed by the most calls first, ties keep the order they were found in
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const struct specialization_candidate &a, const struct specialization_candidate &b) {
+                             return a.calls.size() > b.calls.size();
+                         });
+        unsigned long long size = count_body_instructions(func);
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (i >= SPECIALIZATIONS_PER_FUNCTION || instructions_added + size > budget) {
+                specializations_over_budget += candidates.size() - i;
+                break;
+            }
+            LLVMValueRef specialization = create_specialization(func, candidates[i].constants, i + 1);
+            for (LLVMValueRef call : candidates[i].calls) {
+                LLVMSetOperand(call, LLVMGetNumOperands(call) - 1, specialization); // the called function is the last operand
+                calls_specialized++;
+            }
+            instructions_added += size;
+            specializations.push_back(specialization);
+            specializations_created++;
+        }
+    }
+    return specializations;
+}
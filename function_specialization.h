@@ -0,0 +1,31 @@
+#ifndef FUNCTION_SPECIALIZATION_H
+#define FUNCTION_SPECIALIZATION_H
+
+#include <llvm-c/Core.h>
+#include <vector>
+
+// Specialization of functions for the constants their calls pass
+//
+// When a function is called with different constants, no single constant reaches its body and
+// interprocedural constant propagation cannot help. Specialization copies the function once per
+// set of constant arguments its calls pass, with those parameters replaced by the constants, and
+// points the matching calls at the copy. The copy is internal and keeps the signature, so a call
+// only changes the function it calls. optimize(module) then runs the pipeline on every copy,
+// where the constants fold, loop bounds in particular.
+//
+// The candidates of a function with an exact definition are the sets of constant arguments of
+// its direct calls, and a set is only worth a copy if one of the parameters it fixes is used. The
+// sets passed by the most calls are specialized first, at most SPECIALIZATIONS_PER_FUNCTION per
+// function, as long as the instructions of all the copies fit in the budget. When
+// constants_are_propagated, a function that nothing outside the module can call, and whose calls
+// all pass the same constants, is left to interprocedural constant propagation, which needs no
+// copy.
+
+#define SPECIALIZATION_DEFAULT_BUDGET 2000 // instructions all the copies of a module may add
+#define SPECIALIZATIONS_PER_FUNCTION 4
+
+// returns the copies created, each named after its function with .specialized.<n> appended.
+// constants_are_propagated tells that propagate_interprocedural_constants runs on the module too.
+std::vector<LLVMValueRef> specialize_functions(LLVMModuleRef module, unsigned long long budget, bool constants_are_propagated);
+
+#endif
@@ -0,0 +1,224 @@
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/DebugInfo.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "function_transfer.h"
+
+std::string print_function_body(LLVMValueRef func) {
+    char *printed = LLVMPrintValueToString(func);
+    std::string text(printed);
+    LLVMDisposeMessage(printed);
+
+    size_t body_start = text.find("{\n");
+    size_t body_end = text.rfind('}');
+    if (body_start == std::string::npos || body_end == std::string::npos || body_end < body_start) {
+        return "";
+    }
+    std::string body;
+    size_t line_start = body_start + 2;
+    while (line_start < body_end) {
+        size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string::npos || line_end > body_end) {
+            line_end = body_end;
+        }
+        std::string line = text.substr(line_start, line_end - line_start);
+        size_t attachment = line.find(", !");
+        if (attachment != std::string::npos) {
+            line.erase(attachment);
+        }
+        body += line;
+        body += '\n';
+        line_start = line_end + 1;
+    }
+    return body;
+}
+
+bool function_body_is_transferable(LLVMValueRef func) {
+    if (LLVMCountBasicBlocks(func) == 0) {
+        return false;
+    }
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            if (LLVMIsATerminatorInst(ins) == NULL && LLVMHasMetadata(ins)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// the globals value refers to, itself or through the operands of a constant expression
+static void collect_referenced_globals(LLVMValueRef value, std::unordered_set<LLVMValueRef> &visited, std::vector<LLVMValueRef> &globals) {
+    if (LLVMIsAConstant(value) == NULL || !visited.insert(value).second) {
+        return;
+    }
+    if (LLVMIsAGlobalValue(value) != NULL) {
+        globals.push_back(value);
+        return;
+    }
+    for (int i = 0; i < LLVMGetNumOperands(value); i++) {
+        collect_referenced_globals(LLVMGetOperand(value, i), visited, globals);
+    }
+}
+
+// a declaration of every global the body of func refers to, followed by the body. Declaring
+// only those keeps the text of a function the same size however large its module is.
+bool build_standalone_function_text(LLVMValueRef func, const char *body, size_t body_size, std::string &text) {
+    // an attribute group of a call would be read as the group of that number in the declarations
+    for (size_t i = 0; i + 1 < body_size; i++) {
+        if (body[i] == '#' && body[i + 1] >= '0' && body[i + 1] <= '9') {
+            return false;
+        }
+    }
+    LLVMModuleRef module = LLVMGetGlobalParent(func);
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    std::unordered_set<LLVMValueRef> visited;
+    std::vector<LLVMValueRef> globals;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            for (int i = 0; i < LLVMGetNumOperands(ins); i++) {
+                collect_referenced_globals(LLVMGetOperand(ins, i), visited, globals);
+            }
+        }
+    }
+
+    LLVMModuleRef declarations = LLVMModuleCreateWithNameInContext("transferred_function_declarations", context);
+    LLVMSetDataLayout(declarations, LLVMGetDataLayoutStr(module));
+    LLVMSetTarget(declarations, LLVMGetTarget(module));
+    size_t name_length;
+    for (LLVMValueRef global : globals) {
+        const char *name = LLVMGetValueName2(global, &name_length);
+        // unnamed globals cannot be referenced by name from the parsed text, nor can aliases be declared
+        if (name_length == 0 || (LLVMIsAFunction(global) == NULL && LLVMIsAGlobalVariable(global) == NULL)) {
+            LLVMDisposeModule(declarations);
+            return false;
+        }
+        if (LLVMIsAFunction(global) != NULL) {
+            // the passes read what a call may do from the attributes of its callee
+            LLVMValueRef declaration = LLVMAddFunction(declarations, name, LLVMGlobalGetValueType(global));
+            std::vector<LLVMAttributeRef> attributes(LLVMGetAttributeCountAtIndex(global, LLVMAttributeFunctionIndex));
+            LLVMGetAttributesAtIndex(global, LLVMAttributeFunctionIndex, attributes.data());
+            for (LLVMAttributeRef attribute : attributes) {
+                LLVMAddAttributeAtIndex(declaration, LLVMAttributeFunctionIndex, attribute);
+            }
+        } else {
+            LLVMAddGlobalInAddressSpace(declarations, LLVMGlobalGetValueType(global), name, LLVMGetPointerAddressSpace(LLVMTypeOf(global)));
+        }
+    }
+    char *printed_declarations = LLVMPrintModuleToString(declarations);
+    text = printed_declarations;
+    LLVMDisposeMessage(printed_declarations);
+    LLVMDisposeModule(declarations);
+    // a named struct would be parsed again as a new, different type, so such modules are left alone
+    if (text.find(" = type ") != std::string::npos) {
+        return false;
+    }
+
+    // the header of the spliced function names its parameters the way the printer does
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(func);
+    char *printed_return_type = LLVMPrintTypeToString(LLVMGetReturnType(function_type));
+    text += std::string("define ") + printed_return_type + " @" TRANSFERRED_FUNCTION_NAME "(";
+    LLVMDisposeMessage(printed_return_type);
+    unsigned unnamed_parameter_number = 0;
+    for (unsigned i = 0; i < LLVMCountParams(func); i++) {
+        LLVMValueRef parameter = LLVMGetParam(func, i);
+        char *printed_parameter_type = LLVMPrintTypeToString(LLVMTypeOf(parameter));
+        const char *name = LLVMGetValueName2(parameter, &name_length);
+        text += (i == 0 ? "" : ", ") + std::string(printed_parameter_type) + " %";
+        text += name_length > 0 ? "\"" + std::string(name, name_length) + "\"" : std::to_string(unnamed_parameter_number++);
+        LLVMDisposeMessage(printed_parameter_type);
+    }
+    if (LLVMIsFunctionVarArg(function_type)) {
+        text += LLVMCountParams(func) == 0 ? "..." : ", ...";
+    }
+    text += ") {\n";
+    text.append(body, body_size);
+    text += "}\n";
+    return true;
+}
+
+// parses the standalone text in the context of func and moves the parsed blocks into func
+bool splice_function_body(LLVMValueRef func, const char *body, size_t body_size) {
+    LLVMModuleRef module = LLVMGetGlobalParent(func);
+    LLVMContextRef context = LLVMGetModuleContext(module);
+    std::string text;
+    if (!build_standalone_function_text(func, body, body_size, text)) {
+        return false;
+    }
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(func);
+    size_t name_length;
+
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(text.data(), text.size(), "transferred_function");
+    LLVMModuleRef parsed = NULL;
+    char *err_message = NULL;
+    if (LLVMParseIRInContext(context, buffer, &parsed, &err_message)) { // the parser owns the buffer
+        if (err_message != NULL) LLVMDisposeMessage(err_message);
+        if (parsed) LLVMDisposeModule(parsed);
+        return false;
+    }
+    LLVMValueRef spliced = LLVMGetNamedFunction(parsed, TRANSFERRED_FUNCTION_NAME);
+    if (spliced == NULL || LLVMGlobalGetValueType(spliced) != function_type || LLVMCountBasicBlocks(spliced) != LLVMCountBasicBlocks(func)) {
+        LLVMDisposeModule(parsed);
+        return false;
+    }
+
+    // references to the declarations have to point to the real globals
+    for (LLVMValueRef other = LLVMGetFirstFunction(parsed); other != NULL; other = LLVMGetNextFunction(other)) {
+        if (other == spliced) continue;
+        LLVMReplaceAllUsesWith(other, LLVMGetNamedFunction(module, LLVMGetValueName2(other, &name_length)));
+    }
+    for (LLVMValueRef global = LLVMGetFirstGlobal(parsed); global != NULL; global = LLVMGetNextGlobal(global)) {
+        LLVMReplaceAllUsesWith(global, LLVMGetNamedGlobal(module, LLVMGetValueName2(global, &name_length)));
+    }
+    for (unsigned i = 0; i < LLVMCountParams(func); i++) {
+        LLVMReplaceAllUsesWith(LLVMGetParam(spliced, i), LLVMGetParam(func, i));
+    }
+
+    // terminator metadata (e.g. !llvm.loop) was left out of the printed body, it is copied by position
+    std::vector<LLVMBasicBlockRef> old_blocks;
+    LLVMBasicBlockRef new_bb = LLVMGetFirstBasicBlock(spliced);
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        old_blocks.push_back(bb);
+        LLVMValueRef old_terminator = LLVMGetBasicBlockTerminator(bb);
+        LLVMValueRef new_terminator = LLVMGetBasicBlockTerminator(new_bb);
+        if (old_terminator != NULL && new_terminator != NULL) {
+            size_t number_of_entries;
+            LLVMValueMetadataEntry *entries = LLVMInstructionGetAllMetadataOtherThanDebugLoc(old_terminator, &number_of_entries);
+            for (size_t i = 0; i < number_of_entries; i++) {
+                LLVMSetMetadata(new_terminator, LLVMValueMetadataEntriesGetKind(entries, i),
+                                LLVMMetadataAsValue(context, LLVMValueMetadataEntriesGetMetadata(entries, i)));
+            }
+            LLVMDisposeValueMetadataEntries(entries);
+            LLVMInstructionSetDebugLoc(new_terminator, LLVMInstructionGetDebugLoc(old_terminator));
+        }
+        new_bb = LLVMGetNextBasicBlock(new_bb);
+    }
+
+    // the old body is dismantled so that nothing refers to a deleted value
+    for (LLVMBasicBlockRef bb : old_blocks) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            if (LLVMGetTypeKind(LLVMTypeOf(ins)) != LLVMVoidTypeKind) {
+                LLVMReplaceAllUsesWith(ins, LLVMGetUndef(LLVMTypeOf(ins)));
+            }
+        }
+    }
+    for (LLVMBasicBlockRef bb : old_blocks) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (terminator != NULL) {
+            LLVMInstructionEraseFromParent(terminator);
+        }
+    }
+    for (LLVMBasicBlockRef bb : old_blocks) {
+        LLVMDeleteBasicBlock(bb);
+    }
+
+    while (LLVMGetFirstBasicBlock(spliced) != NULL) {
+        LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(spliced);
+        LLVMRemoveBasicBlockFromParent(bb);
+        LLVMAppendExistingBasicBlock(func, bb);
+    }
+    LLVMDisposeModule(parsed);
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef FUNCTION_TRANSFER_H
+#define FUNCTION_TRANSFER_H
+
+#include <stddef.h>
+#include <llvm-c/Core.h>
+#include <string>
+
+// Moving the body of a function as text, between runs or between LLVM contexts
+//
+// A body is printed without its metadata attachments, since their numbering depends on the rest
+// of the module. To read it back a module is printed that declares every global of the original
+// module and defines TRANSFERRED_FUNCTION_NAME, with the signature of the function and the body.
+// That text parses in any context: the function cache parses it in the context of the module,
+// and a worker thread of optimize(module) in a context of its own. Splicing moves the parsed
+// blocks into the real function and points them back at the real globals. The declared
+// functions keep their function attributes, which tell the passes what a call may do.
+
+// name given to the body while it is parsed, before its blocks move into the real function
+#define TRANSFERRED_FUNCTION_NAME "__optimizer_transferred_body"
+
+// only terminators may carry metadata, since the passes never add, remove or reorder terminators
+// their attachments can be copied back by position after a splice
+bool function_body_is_transferable(LLVMValueRef func);
+
+// the text between the opening and the closing brace of the printed function, without metadata
+std::string print_function_body(LLVMValueRef func);
+
+// the module text defining TRANSFERRED_FUNCTION_NAME with the type of func and body, false when
+// the module of func cannot be declared as text (unnamed globals, named struct types) or a call
+// of body refers to an attribute group
+bool build_standalone_function_text(LLVMValueRef func, const char *body, size_t body_size, std::string &text);
+
+// replaces the body of func with body, which must have as many blocks. False if it does not parse.
+bool splice_function_body(LLVMValueRef func, const char *body, size_t body_size);
+
+#endif
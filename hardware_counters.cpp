@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "hardware_counters.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+bool hardware_counters_enabled = false;
+
+const char *hardware_counter_names[NUMBER_OF_HARDWARE_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "L1d_misses",
+    "LLC_misses",
+    "branch_misses",
+};
+
+#ifdef __linux__
+
+struct counter_group {
+    bool opened = false;
+    int leader_fd = -1;
+    int fds[NUMBER_OF_HARDWARE_COUNTERS] = {-1, -1, -1, -1, -1};
+    // position of each counter in the group read, -1 when it could not be opened
+    int read_position[NUMBER_OF_HARDWARE_COUNTERS] = {-1, -1, -1, -1, -1};
+    int number_opened = 0;
+
+    // the group lives as long as its thread, a worker that exits gives its descriptors back
+    ~counter_group() {
+        for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+            if (fds[counter] != -1) {
+                close(fds[counter]);
+            }
+        }
+    }
+};
+
+static thread_local counter_group thread_counters;
+
+static void describe_event(int counter, struct perf_event_attr &attributes) {
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case HARDWARE_CYCLES: attributes.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case HARDWARE_INSTRUCTIONS: attributes.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case HARDWARE_L1D_READ_MISSES:
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case HARDWARE_LLC_MISSES: attributes.config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case HARDWARE_BRANCH_MISSES: attributes.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    }
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+}
+
+// the first counter that opens leads the group, the others join it
+static int open_thread_counters() {
+    counter_group &group = thread_counters;
+    group.opened = true;
+    int first_error = 0;
+    for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+        struct perf_event_attr attributes;
+        describe_event(counter, attributes);
+        attributes.disabled = group.leader_fd == -1;
+        int fd = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, group.leader_fd, 0);
+        if (fd == -1) {
+            if (first_error == 0) first_error = errno;
+            continue;
+        }
+        if (group.leader_fd == -1) {
+            group.leader_fd = fd;
+        }
+        group.fds[counter] = fd;
+        group.read_position[counter] = group.number_opened++;
+    }
+    if (group.leader_fd != -1) {
+        ioctl(group.leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group.leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    return first_error;
+}
+
+bool hardware_counters_start() {
+    int error = thread_counters.opened ? 0 : open_thread_counters();
+    if (thread_counters.number_opened == 0) {
+        fprintf(stderr, "Hardware counters are not available (%s), check /proc/sys/kernel/perf_event_paranoid; only the times are reported\n",
+                error != 0 ? strerror(error) : "no counter could be opened");
+        hardware_counters_enabled = false;
+        return false;
+    }
+    for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+        if (thread_counters.fds[counter] == -1) {
+            fprintf(stderr, "Hardware counter %s is not available and is reported as n/a\n", hardware_counter_names[counter]);
+        }
+    }
+    hardware_counters_enabled = true;
+    return true;
+}
+
+void hardware_counters_read(unsigned long long counts[NUMBER_OF_HARDWARE_COUNTERS]) {
+    if (!thread_counters.opened) {
+        open_thread_counters(); // threads other than the one that called hardware_counters_start
+    }
+    memset(counts, 0, sizeof(unsigned long long) * NUMBER_OF_HARDWARE_COUNTERS);
+    if (thread_counters.leader_fd == -1) {
+        return;
+    }
+    // nr, time_enabled, time_running and then one value per opened counter
+    unsigned long long buffer[3 + NUMBER_OF_HARDWARE_COUNTERS];
+    if (read(thread_counters.leader_fd, buffer, sizeof(buffer)) <= 0) {
+        return;
+    }
+    unsigned long long time_enabled = buffer[1];
+    unsigned long long time_running = buffer[2];
+    for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+        int position = thread_counters.read_position[counter];
+        if (position == -1) {
+            continue;
+        }
+        unsigned long long value = buffer[3 + position];
+        if (time_running != 0 && time_running < time_enabled) {
+            value = (unsigned long long) ((double) value * time_enabled / time_running);
+        }
+        counts[counter] = value;
+    }
+}
+
+bool hardware_counter_is_available(int counter) {
+    return thread_counters.fds[counter] != -1;
+}
+
+#else
+
+bool hardware_counters_start() {
+    fprintf(stderr, "%s\n", "Hardware counters need Linux perf_event_open; only the times are reported");
+    hardware_counters_enabled = false;
+    return false;
+}
+
+void hardware_counters_read(unsigned long long counts[NUMBER_OF_HARDWARE_COUNTERS]) {
+    memset(counts, 0, sizeof(unsigned long long) * NUMBER_OF_HARDWARE_COUNTERS);
+}
+
+bool hardware_counter_is_available(int counter) {
+    (void) counter;
+    return false;
+}
+
+#endif
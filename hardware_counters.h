@@ -0,0 +1,36 @@
+#ifndef HARDWARE_COUNTERS_H
+#define HARDWARE_COUNTERS_H
+
+#include <stdio.h>
+
+// Hardware performance counters read around every timed pass (Linux perf_event_open)
+//
+// Each thread opens one counter group for itself, user space only, the first time it reads it. A
+// counter the kernel, the CPU or the container does not provide is left out and reported as n/a;
+// when none can be opened hardware_counters_start() says so and the timings are all that is left.
+// The values are scaled by time_enabled / time_running when the kernel had to multiplex the group.
+
+#define NUMBER_OF_HARDWARE_COUNTERS 5
+
+enum hardware_counter {
+    HARDWARE_CYCLES,
+    HARDWARE_INSTRUCTIONS,
+    HARDWARE_L1D_READ_MISSES,
+    HARDWARE_LLC_MISSES,
+    HARDWARE_BRANCH_MISSES,
+};
+
+extern bool hardware_counters_enabled;
+extern const char *hardware_counter_names[NUMBER_OF_HARDWARE_COUNTERS];
+
+// opens the counters of the calling thread and enables the collection, false (with the reason on
+// stderr) when no counter is available
+bool hardware_counters_start();
+
+// current values of the calling thread's counters, 0 for the unavailable ones
+void hardware_counters_read(unsigned long long counts[NUMBER_OF_HARDWARE_COUNTERS]);
+
+// whether the calling thread could open the counter
+bool hardware_counter_is_available(int counter);
+
+#endif
@@ -0,0 +1,194 @@
+#include <string.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <string>
+#include <vector>
+#include "inliner.h"
+#include "function_cloning.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(calls_inlined, "inliner", "Number of calls inlined");
+OPTIMIZER_STATISTIC(calls_over_threshold, "inliner", "Number of calls not inlined because of the cost threshold or the caller size limit");
+OPTIMIZER_STATISTIC(recursive_calls_skipped, "inliner", "Number of calls not inlined because they stay within a strongly connected component");
+OPTIMIZER_STATISTIC(calls_not_inlinable, "inliner", "Number of calls not inlined because of noinline or what the callee contains");
+
+static bool has_function_attribute(LLVMValueRef func, const char *name) {
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    return LLVMGetEnumAttributeAtIndex(func, LLVMAttributeFunctionIndex, kind) != NULL;
+}
+
+static bool call_has_function_attribute(LLVMValueRef call, const char *name) {
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    return LLVMGetCallSiteEnumAttribute(call, LLVMAttributeFunctionIndex, kind) != NULL;
+}
+
+// what inline_call can copy: a plain body whose only way out is a return
+static bool can_be_inlined(LLVMValueRef callee) {
+    if (LLVMIsFunctionVarArg(LLVMGlobalGetValueType(callee)) || LLVMHasPersonalityFn(callee)) {
+        return false;
+    }
+    // the body works on a copy the call makes, binding it to the caller's pointer would write through
+    for (unsigned i = 0; i < LLVMCountParams(callee); i++) {
+        if (parameter_is_passed_by_copy(callee, i)) return false;
+    }
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(callee);
+    for (LLVMBasicBlockRef bb = entry; bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            switch (LLVMGetInstructionOpcode(ins)) {
+            case LLVMInvoke:
+            case LLVMCallBr:
+            case LLVMIndirectBr:
+            case LLVMLandingPad:
+            case LLVMResume:
+            case LLVMCleanupRet:
+            case LLVMCatchRet:
+            case LLVMCatchSwitch:
+            case LLVMCatchPad:
+            case LLVMCleanupPad:
+                return false;
+            case LLVMAlloca: // an alloca in a loop of the caller would grow the stack on every iteration
+                if (bb != entry) return false;
+                // it moves to the entry of the caller, where a count computed later is not defined yet
+                if (!LLVMIsConstant(LLVMGetOperand(ins, 0))) return false;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// the call passes exactly the callee's parameters, with no operand bundle
+static bool call_matches_callee(LLVMValueRef call, LLVMValueRef callee) {
+    return LLVMGetCalledFunctionType(call) == LLVMGlobalGetValueType(callee) &&
+           LLVMGetNumArgOperands(call) == LLVMCountParams(callee) &&
+           (unsigned) LLVMGetNumOperands(call) == LLVMGetNumArgOperands(call) + 1;
+}
+
+static unsigned long long inline_cost(LLVMValueRef call, LLVMValueRef callee, unsigned long long callee_instructions) {
+    unsigned long long folded_uses = 0;
+    for (unsigned i = 0; i < LLVMCountParams(callee); i++) {
+        LLVMValueRef argument = LLVMGetOperand(call, i);
+        if (!LLVMIsConstant(argument) || LLVMIsUndef(argument)) continue;
+        for (LLVMUseRef use = LLVMGetFirstUse(LLVMGetParam(callee, i)); use != NULL; use = LLVMGetNextUse(use)) {
+            folded_uses++;
+        }
+    }
+    return callee_instructions > folded_uses ? callee_instructions - folded_uses : 0;
+}
+
+// The block of the call is split in two: what comes before the call moves to a new block that
+// takes over the predecessors, and the call starts the old block, which keeps the terminator so
+// the phis of its successors stay right. A copy of the callee goes in between, its returns branch
+// to the old block and a phi there merges the returned values in place of the call.
+static void inline_call(LLVMValueRef call, LLVMValueRef callee) {
+    LLVMBasicBlockRef call_block = LLVMGetInstructionParent(call);
+    LLVMValueRef caller = LLVMGetBasicBlockParent(call_block);
+    LLVMContextRef context = LLVMGetTypeContext(LLVMTypeOf(call));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(context);
+    LLVMMetadataRef call_location = LLVMInstructionGetDebugLoc(call);
+
+    // the first half keeps the name, the second is named after the callee like LLVM's inliner does
+    std::string block_name = value_name(LLVMBasicBlockAsValue(call_block));
+    LLVMSetValueName2(LLVMBasicBlockAsValue(call_block), "", 0);
+    LLVMBasicBlockRef head = LLVMInsertBasicBlockInContext(context, call_block, block_name.c_str());
+    std::string exit_name = value_name(callee) + ".exit";
+    LLVMSetValueName2(LLVMBasicBlockAsValue(call_block), exit_name.c_str(), exit_name.size());
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(caller); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (terminator == NULL) continue;
+        for (unsigned i = 0; i < LLVMGetNumSuccessors(terminator); i++) {
+            if (LLVMGetSuccessor(terminator, i) == call_block) {
+                LLVMSetSuccessor(terminator, i, head);
+            }
+        }
+    }
+    LLVMPositionBuilderAtEnd(builder, head);
+    for (LLVMValueRef ins = LLVMGetFirstInstruction(call_block); ins != call; ins = LLVMGetFirstInstruction(call_block)) {
+        std::string name = value_name(ins);
+        LLVMInstructionRemoveFromParent(ins);
+        LLVMInsertIntoBuilderWithName(builder, ins, name.c_str());
+    }
+
+    // the callee's allocas go to the caller's entry block, like the caller's own
+    struct function_body_copy copy;
+    for (unsigned i = 0; i < LLVMCountParams(callee); i++) {
+        copy.copy_of[LLVMGetParam(callee, i)] = LLVMGetOperand(call, i);
+    }
+    copy.return_block = call_block;
+    copy.alloca_builder = LLVMCreateBuilderInContext(context);
+    LLVMBasicBlockRef caller_entry = LLVMGetEntryBasicBlock(caller);
+    if (LLVMGetFirstInstruction(caller_entry) != NULL) {
+        LLVMPositionBuilderBefore(copy.alloca_builder, LLVMGetFirstInstruction(caller_entry));
+    } else { // the call was the first instruction of the entry block, which is now head
+        LLVMPositionBuilderAtEnd(copy.alloca_builder, caller_entry);
+    }
+    // the callee's locations belong to its own subprogram, the copies are attributed to the call
+    copy.location = call_location;
+    LLVMBasicBlockRef entry_copy = copy_function_body(callee, caller, call_block, copy);
+    LLVMPositionBuilderAtEnd(builder, head);
+    LLVMBuildBr(builder, entry_copy);
+
+    if (LLVMGetFirstUse(call) != NULL) {
+        LLVMValueRef result;
+        if (copy.returned_values.empty()) { // the callee never returns, neither does the call
+            result = LLVMGetUndef(LLVMTypeOf(call));
+        } else if (copy.returned_values.size() == 1) {
+            result = copy.returned_values[0];
+        } else {
+            LLVMPositionBuilderBefore(builder, call);
+            result = LLVMBuildPhi(builder, LLVMTypeOf(call), "");
+            LLVMInstructionSetDebugLoc(result, call_location);
+            LLVMAddIncoming(result, copy.returned_values.data(), copy.returning_blocks.data(), copy.returned_values.size());
+        }
+        LLVMReplaceAllUsesWith(call, result);
+    }
+    LLVMInstructionEraseFromParent(call);
+    LLVMDisposeBuilder(copy.alloca_builder);
+    LLVMDisposeBuilder(builder);
+}
+
+unsigned inline_calls(LLVMValueRef caller, const struct call_graph &graph, unsigned threshold,
+                      unsigned maximum_caller_instructions) {
+    scoped_pass_timer timer("inliner");
+    std::vector<LLVMValueRef> calls; // taken before anything is inlined, see inliner.h
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(caller); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            if (called_function_with_body(ins) != NULL) {
+                calls.push_back(ins);
+            }
+        }
+    }
+    if (calls.empty()) {
+        return 0;
+    }
+    unsigned caller_scc = graph.scc_of[graph.index_of.at(caller)];
+    unsigned long long caller_instructions = count_body_instructions(caller);
+    unsigned inlined = 0;
+    for (LLVMValueRef call : calls) {
+        LLVMValueRef callee = called_function_with_body(call);
+        if (graph.scc_of[graph.index_of.at(callee)] == caller_scc) {
+            recursive_calls_skipped++;
+            continue;
+        }
+        if (has_function_attribute(callee, "noinline") || call_has_function_attribute(call, "noinline") ||
+            !call_matches_callee(call, callee) || !can_be_inlined(callee)) {
+            calls_not_inlinable++;
+            continue;
+        }
+        unsigned long long callee_instructions = count_body_instructions(callee);
+        bool is_always_inline = has_function_attribute(callee, "alwaysinline");
+        if ((!is_always_inline && inline_cost(call, callee, callee_instructions) > threshold) ||
+            (maximum_caller_instructions != 0 && caller_instructions + callee_instructions > maximum_caller_instructions)) {
+            calls_over_threshold++;
+            continue;
+        }
+        inline_call(call, callee);
+        caller_instructions += callee_instructions;
+        calls_inlined++;
+        inlined++;
+    }
+    return inlined;
+}
@@ -0,0 +1,30 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <llvm-c/Core.h>
+#include "call_graph.h"
+
+// Inlining of small callees
+//
+// optimize(module) with options.inline_threshold set visits the functions in the bottom-up order
+// of the call graph and inlines the calls of each one right before it goes through the pipeline.
+// A callee has therefore already been inlined into and optimized when it is inlined, and what it
+// brings in is cleaned up by the caller's own CSE, folding and propagation.
+//
+// The cost of a call is the number of instructions of the callee, less one for every use of a
+// parameter that gets a constant argument, since those are the ones that fold once the body is in
+// the caller. A call is inlined when its cost is at most the threshold, or when the callee is
+// alwaysinline. Never inlined: noinline callees and call sites, calls within one strongly
+// connected component (recursion), varargs callees, callees with exception handling, indirect
+// branches or allocas outside their entry block. Only the calls a function had before inlining
+// into it started are considered, so a recursive callee inlined once does not pull itself in
+// again.
+
+#define INLINE_DEFAULT_THRESHOLD 25
+
+// returns the number of calls inlined into caller, which must be in graph. The caller does not
+// grow past maximum_caller_instructions, 0 for no limit.
+unsigned inline_calls(LLVMValueRef caller, const struct call_graph &graph, unsigned threshold,
+                      unsigned maximum_caller_instructions);
+
+#endif
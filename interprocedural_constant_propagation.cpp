@@ -0,0 +1,133 @@
+#include <llvm-c/Core.h>
+#include <unordered_set>
+#include <vector>
+#include "interprocedural_constant_propagation.h"
+#include "function_cloning.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(arguments_propagated, "ipcp", "Number of parameters replaced by the constant every call passes");
+OPTIMIZER_STATISTIC(call_results_propagated, "ipcp", "Number of call results replaced by the constant the callee always returns");
+
+// a known constant, undef would let each use pick a different value
+static bool is_propagatable_constant(LLVMValueRef value) {
+    return LLVMIsConstant(value) && !LLVMIsUndef(value);
+}
+
+// the calls to func that call it directly with its own type, false if func is used any other way
+static bool collect_direct_calls(LLVMValueRef func, std::vector<LLVMValueRef> &calls) {
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(func);
+    for (LLVMUseRef use = LLVMGetFirstUse(func); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMIsACallInst(user) == NULL || LLVMGetCalledValue(user) != func ||
+            LLVMGetCalledFunctionType(user) != function_type) {
+            return false;
+        }
+        // func passed as an argument of a call to itself escapes as well
+        for (unsigned i = 0; i < LLVMGetNumArgOperands(user); i++) {
+            if (LLVMGetOperand(user, i) == func) return false;
+        }
+        calls.push_back(user);
+    }
+    return true;
+}
+
+static bool propagate_constant_arguments(LLVMValueRef func) {
+    LLVMLinkage linkage = LLVMGetLinkage(func);
+    if ((linkage != LLVMInternalLinkage && linkage != LLVMPrivateLinkage) || LLVMIsFunctionVarArg(LLVMGlobalGetValueType(func))) {
+        return false;
+    }
+    std::vector<LLVMValueRef> calls;
+    if (!collect_direct_calls(func, calls) || calls.empty()) {
+        return false;
+    }
+    bool changed = false;
+    for (unsigned i = 0; i < LLVMCountParams(func); i++) {
+        LLVMValueRef param = LLVMGetParam(func, i);
+        // the body writes its own copy of a byval argument, never the pointer the call passes
+        if (LLVMGetFirstUse(param) == NULL || parameter_is_passed_by_copy(func, i)) continue;
+        LLVMValueRef constant = LLVMGetOperand(calls[0], i);
+        if (!is_propagatable_constant(constant)) continue;
+        bool is_same_everywhere = true;
+        for (LLVMValueRef call : calls) {
+            if (LLVMGetOperand(call, i) != constant) { // constants are uniqued, the same value is the same pointer
+                is_same_everywhere = false;
+                break;
+            }
+        }
+        if (is_same_everywhere) {
+            LLVMReplaceAllUsesWith(param, constant);
+            arguments_propagated++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// the constant every return of func gives, NULL if there is none
+static LLVMValueRef constant_return_value(LLVMValueRef func) {
+    switch (LLVMGetLinkage(func)) {
+    case LLVMExternalLinkage:
+    case LLVMInternalLinkage:
+    case LLVMPrivateLinkage:
+        break;
+    default: // the body here may not be the one that runs
+        return NULL;
+    }
+    if (LLVMGetTypeKind(LLVMGetReturnType(LLVMGlobalGetValueType(func))) == LLVMVoidTypeKind) {
+        return NULL;
+    }
+    LLVMValueRef constant = NULL;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (terminator == NULL || LLVMGetInstructionOpcode(terminator) != LLVMRet) continue;
+        LLVMValueRef returned = LLVMGetOperand(terminator, 0);
+        if (!is_propagatable_constant(returned) || (constant != NULL && returned != constant)) {
+            return NULL;
+        }
+        constant = returned;
+    }
+    return constant;
+}
+
+// callers whose calls to func had their result replaced are added to changed_functions
+static void propagate_constant_return(LLVMValueRef func, std::unordered_set<LLVMValueRef> &changed_functions) {
+    LLVMValueRef constant = constant_return_value(func);
+    if (constant == NULL) {
+        return;
+    }
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(func);
+    std::vector<LLVMValueRef> calls;
+    for (LLVMUseRef use = LLVMGetFirstUse(func); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMIsACallInst(user) != NULL && LLVMGetCalledValue(user) == func &&
+            LLVMGetCalledFunctionType(user) == function_type && LLVMGetFirstUse(user) != NULL) {
+            calls.push_back(user); // not replaced here, that would change the use list being walked
+        }
+    }
+    for (LLVMValueRef call : calls) {
+        if (LLVMGetFirstUse(call) == NULL) continue; // the same call was seen twice
+        LLVMReplaceAllUsesWith(call, constant);
+        call_results_propagated++;
+        changed_functions.insert(LLVMGetBasicBlockParent(LLVMGetInstructionParent(call)));
+    }
+}
+
+std::vector<LLVMValueRef> propagate_interprocedural_constants(LLVMModuleRef module) {
+    scoped_pass_timer timer("interprocedural_constant_propagation");
+    std::unordered_set<LLVMValueRef> changed_functions;
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (LLVMCountBasicBlocks(func) == 0) continue;
+        if (propagate_constant_arguments(func)) {
+            changed_functions.insert(func);
+        }
+        propagate_constant_return(func, changed_functions);
+    }
+    std::vector<LLVMValueRef> changed_in_module_order;
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (changed_functions.count(func) != 0) {
+            changed_in_module_order.push_back(func);
+        }
+    }
+    return changed_in_module_order;
+}
@@ -0,0 +1,24 @@
+#ifndef INTERPROCEDURAL_CONSTANT_PROPAGATION_H
+#define INTERPROCEDURAL_CONSTANT_PROPAGATION_H
+
+#include <llvm-c/Core.h>
+#include <vector>
+
+// Constant propagation across calls, in the spirit of LLVM's IPSCCP
+//
+// Arguments: a function with internal or private linkage that is only ever called directly, and
+// gets the same constant for a parameter at every call, has that parameter replaced by the
+// constant in its body. Nothing outside the module can call such a function, so every call is
+// known. Return values: when every return of a function with an exact definition (not weak,
+// linkonce or available_externally, which the linker may replace) returns the same constant, the
+// result of every direct call to it is replaced by that constant. The calls stay, they may have
+// side effects.
+//
+// optimize(module) alternates this with the per function pipeline: the constants given here are
+// folded and propagated inside the functions, which can make more arguments and returns constant,
+// and the functions that changed go through the pipeline again until nothing does.
+
+// returns the functions whose body changed, in module order
+std::vector<LLVMValueRef> propagate_interprocedural_constants(LLVMModuleRef module);
+
+#endif
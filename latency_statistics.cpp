@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <vector>
+#include "latency_statistics.h"
+
+void record_latency_sample(struct latency_samples &samples, double elapsed_ms) {
+    if (samples.count == 0 || elapsed_ms < samples.min_ms) {
+        samples.min_ms = elapsed_ms;
+    }
+    samples.max_ms = std::max(samples.max_ms, elapsed_ms);
+    samples.count++;
+    samples.total_ms += elapsed_ms;
+    if (samples.recent_ms.size() < LATENCY_SAMPLES_KEPT) {
+        samples.recent_ms.push_back(elapsed_ms);
+    } else {
+        samples.recent_ms[samples.next_sample] = elapsed_ms;
+    }
+    samples.next_sample = (samples.next_sample + 1) % LATENCY_SAMPLES_KEPT;
+}
+
+struct latency_summary summarize_latency_samples(const struct latency_samples &samples) {
+    std::vector<double> sorted_ms = samples.recent_ms;
+    std::sort(sorted_ms.begin(), sorted_ms.end());
+    struct latency_summary summary;
+    summary.mean_ms = samples.count == 0 ? 0 : samples.total_ms / samples.count;
+    summary.min_ms = samples.min_ms;
+    summary.p50_ms = sorted_ms.empty() ? 0 : sorted_ms[(sorted_ms.size() - 1) * 50 / 100];
+    summary.p99_ms = sorted_ms.empty() ? 0 : sorted_ms[(sorted_ms.size() - 1) * 99 / 100];
+    summary.max_ms = samples.max_ms;
+    return summary;
+}
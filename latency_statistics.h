@@ -0,0 +1,38 @@
+#ifndef LATENCY_STATISTICS_H
+#define LATENCY_STATISTICS_H
+
+#include <stddef.h>
+#include <vector>
+
+// Latencies of repeated operations, summarized as mean, min, max and percentiles
+//
+// Every latency counts in the mean, min and max, and the most recent LATENCY_SAMPLES_KEPT are
+// kept in a ring buffer for the percentiles, so a long running server or JIT holds a bounded
+// number of samples. The caller serializes the calls, the server and the tiers report each hold
+// a lock of their own around them.
+
+#define LATENCY_SAMPLES_KEPT 4096
+
+struct latency_samples {
+    unsigned long long count = 0;
+    double total_ms = 0;
+    double min_ms = 0;
+    double max_ms = 0;
+    std::vector<double> recent_ms; // ring buffer of the last LATENCY_SAMPLES_KEPT latencies
+    size_t next_sample = 0;
+};
+
+struct latency_summary {
+    double mean_ms;
+    double min_ms;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+void record_latency_sample(struct latency_samples &samples, double elapsed_ms);
+
+// all zero when nothing was recorded
+struct latency_summary summarize_latency_samples(const struct latency_samples &samples);
+
+#endif
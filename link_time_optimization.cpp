@@ -0,0 +1,101 @@
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "link_time_optimization.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(modules_linked, "lto", "Number of modules linked into the first one");
+OPTIMIZER_STATISTIC(functions_internalized, "lto", "Number of functions made internal because no other module calls them");
+OPTIMIZER_STATISTIC(dead_functions_removed, "lto", "Number of internal functions deleted because nothing calls them");
+
+// without a handler of our own LLVM prints the linker errors and exits
+static void record_link_error(LLVMDiagnosticInfoRef info, void *error) {
+    if (LLVMGetDiagInfoSeverity(info) != LLVMDSError) {
+        return;
+    }
+    char *description = LLVMGetDiagInfoDescription(info);
+    std::string &messages = *(std::string *) error;
+    messages += (messages.empty() ? "" : "\n") + std::string(description);
+    LLVMDisposeMessage(description);
+}
+
+bool link_modules(LLVMModuleRef destination, std::vector<LLVMModuleRef> &sources, std::string &error) {
+    scoped_pass_timer timer("link_modules");
+    LLVMContextRef context = LLVMGetModuleContext(destination);
+    LLVMDiagnosticHandler previous_handler = LLVMContextGetDiagnosticHandler(context);
+    void *previous_handler_context = LLVMContextGetDiagnosticContext(context);
+    LLVMContextSetDiagnosticHandler(context, record_link_error, &error);
+    bool linked = true;
+    for (LLVMModuleRef source : sources) {
+        if (!linked) {
+            LLVMDisposeModule(source);
+        } else if (LLVMLinkModules2(destination, source)) { // the linker disposes of source
+            linked = false;
+        } else {
+            modules_linked++;
+        }
+    }
+    sources.clear();
+    LLVMContextSetDiagnosticHandler(context, previous_handler, previous_handler_context);
+    return linked;
+}
+
+unsigned internalize_functions(LLVMModuleRef module, const std::vector<std::string> &exported_names) {
+    scoped_pass_timer timer("internalize_functions");
+    unsigned internalized = 0;
+    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+        if (LLVMCountBasicBlocks(func) == 0 || LLVMGetLinkage(func) != LLVMExternalLinkage) {
+            continue;
+        }
+        size_t name_length;
+        const char *name = LLVMGetValueName2(func, &name_length);
+        if (std::find(exported_names.begin(), exported_names.end(), std::string(name, name_length)) != exported_names.end()) {
+            continue;
+        }
+        LLVMSetLinkage(func, LLVMInternalLinkage);
+        // an internal symbol has nothing to make visible or to import from a DLL
+        LLVMSetVisibility(func, LLVMDefaultVisibility);
+        LLVMSetDLLStorageClass(func, LLVMDefaultStorageClass);
+        internalized++;
+    }
+    functions_internalized += internalized;
+    return internalized;
+}
+
+// true if every use of func is an instruction of its own body, recursion does not keep it alive
+static bool is_only_used_by_itself(LLVMValueRef func) {
+    for (LLVMUseRef use = LLVMGetFirstUse(func); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMIsAInstruction(user) == NULL || LLVMGetBasicBlockParent(LLVMGetInstructionParent(user)) != func) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned remove_dead_functions(LLVMModuleRef module) {
+    scoped_pass_timer timer("remove_dead_functions");
+    unsigned removed = 0;
+    // deleting a function drops its calls, which can leave its callees dead in turn
+    bool was_removed = true;
+    while (was_removed) {
+        was_removed = false;
+        LLVMValueRef func = LLVMGetFirstFunction(module);
+        while (func != NULL) {
+            LLVMValueRef next = LLVMGetNextFunction(func);
+            LLVMLinkage linkage = LLVMGetLinkage(func);
+            if (LLVMCountBasicBlocks(func) != 0 && (linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage) &&
+                is_only_used_by_itself(func)) {
+                LLVMDeleteFunction(func);
+                removed++;
+                was_removed = true;
+            }
+            func = next;
+        }
+    }
+    dead_functions_removed += removed;
+    return removed;
+}
@@ -0,0 +1,29 @@
+#ifndef LINK_TIME_OPTIMIZATION_H
+#define LINK_TIME_OPTIMIZATION_H
+
+#include <llvm-c/Core.h>
+#include <string>
+#include <vector>
+
+// Link-time optimization of a program given as several modules
+//
+// The modules are linked into one with LLVM's IR linker, so calls between them become calls to
+// a body in the same module and the whole-program passes see across the files: the inliner,
+// interprocedural constant propagation and the specialization. Those passes can only rewrite
+// what nothing outside the module calls, so every function other than the exported ones (main,
+// unless told otherwise) is made internal first. Once the calls have been inlined or redirected
+// to copies, the internal functions nothing calls anymore are removed.
+
+// links every source into destination, in order. The sources are consumed even on failure, and
+// error holds the linker's messages when it rejects one.
+bool link_modules(LLVMModuleRef destination, std::vector<LLVMModuleRef> &sources, std::string &error);
+
+// gives internal linkage to every externally visible function with a body whose name is not in
+// exported_names, returns how many were changed
+unsigned internalize_functions(LLVMModuleRef module, const std::vector<std::string> &exported_names);
+
+// deletes the internal and private functions that are only used by their own body, until none
+// is left, and returns how many were deleted
+unsigned remove_dead_functions(LLVMModuleRef module);
+
+#endif
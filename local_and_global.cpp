@@ -1,160 +1,147 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <llvm-c/Core.h>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
-#include <llvm-c/IRReader.h>
+#include <algorithm>
+#include <map>
 #include <string.h>
+#include "local_and_global.h"
+#include "function_attributes.h"
+#include "function_analysis_manager.h"
+#include "compile_budget.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(arithmetic_expressions_replaced, "cse", "Number of add/sub/mul replaced by an earlier identical one");
+OPTIMIZER_STATISTIC(loads_replaced, "cse", "Number of loads replaced by an earlier load of the same pointer");
+OPTIMIZER_STATISTIC(calls_replaced, "cse", "Number of calls replaced by an earlier identical call that reads no memory or that nothing wrote in between");
+OPTIMIZER_STATISTIC(constants_folded, "constant_folding", "Number of instructions folded into a constant");
+OPTIMIZER_STATISTIC(instructions_erased, "dce", "Number of dead instructions erased");
+OPTIMIZER_STATISTIC(fixed_point_rounds, "reaching_definitions", "Number of rounds over the blocks to compute IN and OUT");
+OPTIMIZER_STATISTIC(most_fixed_point_rounds, "reaching_definitions", "Most rounds needed by a single IN and OUT computation");
+OPTIMIZER_STATISTIC(loads_forwarded, "constant_propagation", "Number of loads replaced by the constant every reaching store writes");
+OPTIMIZER_STATISTIC(propagation_rounds, "constant_propagation", "Number of propagation then folding rounds");
+OPTIMIZER_STATISTIC(most_propagation_rounds, "constant_propagation", "Most propagation then folding rounds needed by a single function");
 
-bool run_common_subexpression_elimination(LLVMBasicBlockRef bb);
-bool run_constant_folding(LLVMBasicBlockRef bb);
-bool run_dead_code_elimination(LLVMValueRef func);
-bool is_store_in_between_shared_memory_uses(LLVMValueRef first_instruction, LLVMValueRef second_instruction);
-std::unordered_set <LLVMValueRef> compute_gen_set_for_block(LLVMBasicBlockRef bb);
-std::unordered_set <LLVMValueRef> set_of_all_store (LLVMValueRef func);
-std::unordered_set <LLVMValueRef> compute_kill_set_for_block(LLVMBasicBlockRef bb);
-std::unordered_map <LLVMBasicBlockRef, std::unordered_set <LLVMBasicBlockRef>> compute_predecesor_blocks (LLVMValueRef func);
-bool taking_load_into_consideration(LLVMValueRef func);
-bool instruction_should_be_kept(LLVMValueRef instruction);
-void constant_propagation_and_constant_folding(LLVMValueRef func);
-std::unordered_map <LLVMBasicBlockRef, struct IN_and_OUT> in_and_out_sets_map(LLVMValueRef func);
-
-struct IN_and_OUT {
-    std::unordered_set <LLVMValueRef> in_set;
-    std::unordered_set <LLVMValueRef> out_set;
-};
+// functions for local tasks of optimization
 
-// Processes input .ll file and outputs a file with the optimized version
-int main(int argc, char *argv[]){
-    // edge case where the user did not provide adequate input
-    if (argc != 2) {
-        fprintf(stderr, "%s", "You need to provide only the path to the .ll file to optimize");
-        exit(1);
-    }
+// an add, sub or mul is identified by its opcode and operands, the operands of the commutative
+// add and mul in pointer order so that a + b and b + a have the same key
+struct expression_key {
+    LLVMOpcode opcode;
+    LLVMValueRef first_operand;
+    LLVMValueRef second_operand;
 
-    // to guarantee the user has provided the correct extension
-    char* input_file_with_extension = argv[1];
-    int length_of_input_file = strlen(input_file_with_extension);
-    char input_extension[4];
-    int i;
-    int j = 0; //tracks which char of the input_extension we are in
-    if (length_of_input_file < 3) {
-        fprintf(stderr, "%s\n", "You should provide a file with extension .ll therefore the length of the name should be more than 3.");
-        exit(2);
-    }
-    for(i = length_of_input_file - 3; i < length_of_input_file; i++){
-        input_extension[j] = input_file_with_extension[i];
-        j++;
-    }
-    input_extension[j] = '\0';
-    if (strcmp(input_extension, ".ll") != 0) { // if they are not equal incorrect input has been provided
-        fprintf(stderr, "%s\n", "You provided a file with the incorect extension. I t should be .ll");
-        exit(3);
-    }
-    
-    // buffer to store the contents to be parsed
-    LLVMMemoryBufferRef buffer = NULL;
-    char *err_message = NULL;
-    // arg[1] is the name of the input file
-    LLVMBool did_fail = LLVMCreateMemoryBufferWithContentsOfFile(argv[1],
-                                                  &buffer,
-                                                  &err_message);
-    if (did_fail){
-        fprintf(stderr, "%s", err_message);
-        LLVMDisposeMessage(err_message);
-        if (buffer) {
-            LLVMDisposeMemoryBuffer(buffer);
-        }
-        exit(4);
+    bool operator==(const expression_key &other) const {
+        return opcode == other.opcode && first_operand == other.first_operand && second_operand == other.second_operand;
     }
+};
 
-    
-    // parsing process starts
-    LLVMContextRef context_for_parser = LLVMContextCreate();
-    LLVMModuleRef module = NULL; //filled by function
-    LLVMBool parsing_failed = LLVMParseIRInContext(context_for_parser,
-                                         buffer,
-                                         &module,
-                                         &err_message);
-    if (parsing_failed){
-        fprintf(stderr, "%s", err_message);
-        LLVMDisposeMessage(err_message);
-        if (module) {
-            LLVMDisposeModule(module);
-        }
-        LLVMContextDispose(context_for_parser);
-        LLVMDisposeMemoryBuffer(buffer);
-        exit(5);
+struct expression_key_hash {
+    size_t operator()(const expression_key &key) const {
+        return (size_t) (mix_pointer_hash(key.first_operand) * 31 + mix_pointer_hash(key.second_operand) + key.opcode);
     }
+};
 
-    // optimization is applied per function
-    for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
-        if (LLVMCountBasicBlocks(func) == 0) { // there is nothing to process so we continue
-            continue;
-        }
-        // local optimizations
-        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-            run_common_subexpression_elimination(bb);
-            run_constant_folding(bb);
-        }
-        run_dead_code_elimination(func);
-        // global optimization until fixed point
-        constant_propagation_and_constant_folding(func);
-    }
+// a call is identified by its type, its callee and its arguments
+typedef std::pair<LLVMTypeRef, std::vector<LLVMValueRef>> call_key;
 
-    // after all the optimization has been performed we write the output to terminal
-    LLVMDumpModule(module);
-    // and then dispose
-    if (err_message != NULL) LLVMDisposeMessage(err_message);
-    LLVMDisposeModule(module);
-    LLVMContextDispose(context_for_parser);
-    return 0;
+static call_key key_of_call(LLVMValueRef call) {
+    call_key key(LLVMTypeOf(call), std::vector<LLVMValueRef>(1, LLVMGetCalledValue(call)));
+    for (unsigned i = 0; i < LLVMGetNumArgOperands(call); i++) {
+        key.second.push_back(LLVMGetOperand(call, i));
+    }
+    return key;
 }
 
-// functions for local tasks of optimization
+// replaces call by an earlier call with the same key if there is one, remembers it otherwise
+static bool replace_by_earlier_call(LLVMValueRef call, std::map<call_key, LLVMValueRef> &earlier_calls) {
+    auto found = earlier_calls.emplace(key_of_call(call), call);
+    if (found.second) {
+        return false;
+    }
+    bool was_used = LLVMGetFirstUse(call) != NULL;
+    calls_replaced += was_used;
+    LLVMReplaceAllUsesWith(call, found.first->second);
+    return was_used;
+}
 
 bool run_common_subexpression_elimination(LLVMBasicBlockRef bb){
+    scoped_pass_timer timer("run_common_subexpression_elimination");
     bool replacement_has_happened = false;
     // If we find that a instruction is repeated we substitute the later
     //  reference with the first one so 
     // that dead code elimination later simplifies the code
-    for (LLVMValueRef ins_1 = LLVMGetFirstInstruction(bb); ins_1 != NULL; ins_1 = LLVMGetNextInstruction(ins_1)) {
-
-        for (LLVMValueRef ins_2 = LLVMGetNextInstruction(ins_1); ins_2 != NULL;) {
-
-            LLVMValueRef ins_2_next = LLVMGetNextInstruction(ins_2);
-            LLVMOpcode type_of_ins_1 = LLVMGetInstructionOpcode(ins_1);
-
-            if (type_of_ins_1 == LLVMGetInstructionOpcode(ins_2) && (type_of_ins_1 == LLVMAdd || type_of_ins_1 == LLVMMul || type_of_ins_1 == LLVMSub)) {
-
-                LLVMOpcode shared_type_of_ins = type_of_ins_1;
-                bool operands_are_the_same_in_order = (LLVMGetOperand(ins_1, 0) == LLVMGetOperand(ins_2, 0) && LLVMGetOperand(ins_1, 1) == LLVMGetOperand(ins_2, 1));
-                bool operands_are_the_same_in_opposite_order = (LLVMGetOperand(ins_1, 0) == LLVMGetOperand(ins_2, 1) && LLVMGetOperand(ins_1, 1) == LLVMGetOperand(ins_2, 0));
-                bool operands_are_communitatively_the_same = (operands_are_the_same_in_order || operands_are_the_same_in_opposite_order);
+    // One walk over the block: the first instruction computing each expression is remembered, and
+    // for each pointer the first load since the last store to it. Calls that read no memory are
+    // remembered like expressions, calls that only read like loads, until something may write.
+    std::unordered_map<expression_key, LLVMValueRef, expression_key_hash> first_computation;
+    analysis_map<LLVMValueRef, LLVMValueRef> available_load;
+    std::map<call_key, LLVMValueRef> first_pure_call;
+    std::map<call_key, LLVMValueRef> available_reading_call;
+    std::vector<LLVMValueRef> clobbered_pointers;
+    for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+        LLVMOpcode type_of_ins = LLVMGetInstructionOpcode(ins);
 
-                // b/c addition and multiplication are commutative so they are the same subexpression if the sets with operands in the instructions are equal
-                if (operands_are_communitatively_the_same && (shared_type_of_ins == LLVMAdd || shared_type_of_ins == LLVMMul)) {
-                    LLVMReplaceAllUsesWith(ins_2, ins_1);
-                    replacement_has_happened = true; // we have replacement_has_happened in each if statement content b/c if we have the case where the operands the the same in opposite order but shared_type_of_ins is substraction then we cannot substitute 
-                }
-                // we handle substraction separately b/c substraction is not commutative so it requires the same order
-                if (operands_are_the_same_in_order && shared_type_of_ins == LLVMSub){
-                    LLVMReplaceAllUsesWith(ins_2, ins_1);
-                    replacement_has_happened =true;
+        if (type_of_ins == LLVMAdd || type_of_ins == LLVMMul || type_of_ins == LLVMSub) {
+            struct expression_key key = {type_of_ins, LLVMGetOperand(ins, 0), LLVMGetOperand(ins, 1)};
+            // b/c addition and multiplication are commutative, substraction is not so it requires the same order
+            if (type_of_ins != LLVMSub && key.second_operand < key.first_operand) {
+                std::swap(key.first_operand, key.second_operand);
+            }
+            auto found = first_computation.emplace(key, ins);
+            if (!found.second) {
+                // an earlier replacement may have left ins unused already, that is not a change
+                if (LLVMGetFirstUse(ins) != NULL) {
+                    arithmetic_expressions_replaced++;
+                    replacement_has_happened = true;
                 }
+                LLVMReplaceAllUsesWith(ins, found.first->second);
             }
+        }
 
-            // we separate these conditionals for readability
-
-            if ((type_of_ins_1 == LLVMLoad && LLVMGetInstructionOpcode(ins_2) == LLVMLoad) && (LLVMGetOperand(ins_1, 0) == LLVMGetOperand(ins_2, 0))){
-                if (!is_store_in_between_shared_memory_uses(ins_1, ins_2)){
-                    LLVMReplaceAllUsesWith(ins_2, ins_1);
+        if (type_of_ins == LLVMLoad) {
+            LLVMValueRef &earlier_load = available_load[LLVMGetOperand(ins, 0)];
+            if (earlier_load == NULL) {
+                earlier_load = ins;
+            } else {
+                if (LLVMGetFirstUse(ins) != NULL) {
+                    loads_replaced++;
                     replacement_has_happened = true;
                 }
+                LLVMReplaceAllUsesWith(ins, earlier_load);
             }
+        }
+
+        if (type_of_ins == LLVMStore) { // later loads of the pointer may read another value
+            available_load.erase(LLVMGetOperand(ins, 1));
+            available_reading_call.clear();
+        }
 
-            ins_2 = ins_2_next;
+        struct memory_effects effects = type_of_ins == LLVMCall ? memory_effects_of_call(ins) : memory_effects();
+        if (type_of_ins == LLVMCall && LLVMGetTypeKind(LLVMTypeOf(ins)) != LLVMVoidTypeKind) {
+            if (call_is_pure(ins)) {
+                replacement_has_happened |= replace_by_earlier_call(ins, first_pure_call);
+            } else if (!effects.writes() && LLVMIsAFunction(LLVMGetCalledValue(ins)) != NULL) {
+                replacement_has_happened |= replace_by_earlier_call(ins, available_reading_call);
+            }
+        }
+
+        if (effects.writes()) {
+            // only the allocas no call can reach keep their loads
+            available_reading_call.clear();
+            clobbered_pointers.clear();
+            for (const auto &entry : available_load) {
+                if (!is_unescaped_alloca(entry.first)) {
+                    clobbered_pointers.push_back(entry.first);
+                }
+            }
+            for (LLVMValueRef pointer : clobbered_pointers) {
+                available_load.erase(pointer);
+            }
         }
     }
     return replacement_has_happened;
@@ -177,6 +164,7 @@ bool is_store_in_between_shared_memory_uses(LLVMValueRef first_instruction, LLVM
 }
 
 bool run_constant_folding(LLVMBasicBlockRef bb){
+    scoped_pass_timer timer("run_constant_folding");
     bool changed = false; // to indicate if constant folding has been performed
 
     LLVMValueRef instruction = LLVMGetFirstInstruction(bb);
@@ -213,6 +201,7 @@ bool run_constant_folding(LLVMBasicBlockRef bb){
             if (folded_result != NULL){
                 LLVMReplaceAllUsesWith(instruction, folded_result);
                 LLVMInstructionEraseFromParent(instruction);
+                constants_folded++;
                 changed = true;
             }
             
@@ -226,40 +215,49 @@ bool instruction_should_be_kept(LLVMValueRef instruction){
     LLVMOpcode ins_type = LLVMGetInstructionOpcode(instruction);
     // if we have any of the following cases then they are relevant in control flow and memory allocation
     // thus removing them would be dangerous for the successful execution of the program
-    if (LLVMIsATerminatorInst(instruction) != NULL || ins_type == LLVMStore || ins_type == LLVMCall) {
+    if (LLVMIsATerminatorInst(instruction) != NULL || ins_type == LLVMStore) {
         return true;
     }
+    // unless the attributes say it writes nothing, cannot unwind and returns
+    if (ins_type == LLVMCall) {
+        return !call_is_removable_if_unused(instruction);
+    }
 
     return false;
 }
 
 
 bool run_dead_code_elimination(LLVMValueRef func){
-    // has_changed useful to get to the fixed point state. If we have reached a 
-    // cycle on which there is no change then all dead code elimination has been performed
-    bool has_changed_this_cycle = true;  // we initialize to true just to start the loop
-    bool has_changed_at_all = false;
-
-    while (has_changed_this_cycle){
-
-        has_changed_this_cycle = false;
-
-        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-
-            for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst != NULL; ) {
-                LLVMValueRef next = LLVMGetNextInstruction(inst);
-                
-                bool is_unused = (LLVMGetFirstUse(inst) == NULL);
-
-                if (is_unused && !instruction_should_be_kept(inst)) {
-
-                    LLVMInstructionEraseFromParent(inst);
-
-                    has_changed_this_cycle = true;
-                    has_changed_at_all = true;
-                }
-
-                inst = next;
+    scoped_pass_timer timer("run_dead_code_elimination");
+    // the instructions that are unused to begin with, then every operand left without uses by an
+    // erasure, so each instruction is looked at a bounded number of times instead of once per round
+    std::vector<LLVMValueRef> dead_instructions;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst != NULL; inst = LLVMGetNextInstruction(inst)) {
+            if (LLVMGetFirstUse(inst) == NULL && !instruction_should_be_kept(inst)) {
+                dead_instructions.push_back(inst);
+            }
+        }
+    }
+    bool has_changed_at_all = !dead_instructions.empty();
+
+    std::vector<LLVMValueRef> operands;
+    while (!dead_instructions.empty()) {
+        LLVMValueRef inst = dead_instructions.back();
+        dead_instructions.pop_back();
+        operands.clear();
+        for (int i = 0; i < LLVMGetNumOperands(inst); i++) {
+            LLVMValueRef operand = LLVMGetOperand(inst, i);
+            if (LLVMIsAInstruction(operand) != NULL && std::find(operands.begin(), operands.end(), operand) == operands.end()) {
+                operands.push_back(operand);
+            }
+        }
+        LLVMInstructionEraseFromParent(inst);
+        instructions_erased++;
+        // an operand that just lost its last use was not in the list, it had a use until now
+        for (LLVMValueRef operand : operands) {
+            if (LLVMGetFirstUse(operand) == NULL && !instruction_should_be_kept(operand)) {
+                dead_instructions.push_back(operand);
             }
         }
     }
@@ -267,240 +265,187 @@ bool run_dead_code_elimination(LLVMValueRef func){
 }
 
 // computing the set GEN[B] for a basic block B
-std::unordered_set <LLVMValueRef> compute_gen_set_for_block(LLVMBasicBlockRef bb) {
-    std::unordered_set <LLVMValueRef> block_gen_set = {};
+// a store is generated by the block when no later store of the same block writes to its pointer
+void compute_gen_set_for_block(const struct function_snapshot &snapshot, unsigned block, uint64_t *gen_set) {
+    scoped_pass_timer timer("compute_gen_set_for_block");
     // we go over each instruction in the basic block
-    for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
-        LLVMOpcode type_of_ins = LLVMGetInstructionOpcode(ins);
-        // if a instruction of type store is found then it is inserted
-        if (type_of_ins == LLVMStore) {
-            block_gen_set.insert(ins);
-            LLVMValueRef ptr = LLVMGetOperand(ins, 1);
-            LLVMValueRef ins_to_eliminate = NULL;
-            // if any other instruction that references to the same ptr was already in place it is erased
-            // one at a time
-            for (LLVMValueRef element : block_gen_set) {
-                if (ptr == LLVMGetOperand(element, 1) && element != ins) {
-                    ins_to_eliminate = element;
-                    break;
-                }
-            }
-
-            if (ins_to_eliminate != NULL){
-                block_gen_set.erase(ins_to_eliminate);
-            }
+    for (unsigned ins = snapshot.block_start[block]; ins < snapshot.block_start[block + 1]; ins++) {
+        unsigned store = snapshot.store_number[ins];
+        if (store == SNAPSHOT_NO_INDEX) {
+            continue;
         }
-    }
-    return block_gen_set;
-} 
-
-// computing the set of all store instructions in the function
-std::unordered_set <LLVMValueRef> set_of_all_store (LLVMValueRef func) {
-    std::unordered_set <LLVMValueRef> set_of_all_store = {};
-    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)){
-        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)){
-            LLVMOpcode type_of_ins = LLVMGetInstructionOpcode(ins);
-            if (type_of_ins == LLVMStore) {
-                set_of_all_store.insert(ins);
-            }
+        unsigned next_store = snapshot.next_store_to_same_pointer[store];
+        if (next_store == SNAPSHOT_NO_INDEX || snapshot.block_of_instruction[snapshot.store_instruction[next_store]] != block) {
+            set_bit(gen_set, store);
         }
     }
-    return set_of_all_store;
 }
 
 // computing the set KILL[B] for a basic block B
 // for each store instruction in the basic block to a pointer, the kill set is the set of all other store instructions to the same pointer in the entire program
-std::unordered_set <LLVMValueRef> compute_kill_set_for_block(LLVMBasicBlockRef bb) {
-
-    std::unordered_set <LLVMValueRef> block_kill_set = {};
-
-    // getting the function to determine the set of all stores
-    LLVMValueRef func = LLVMGetBasicBlockParent(bb);
-    std::unordered_set <LLVMValueRef> set_of_stores = set_of_all_store(func);
-
-    for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)){
-        if (LLVMGetInstructionOpcode(ins) == LLVMStore){
-            for (LLVMValueRef store_ins : set_of_stores) {
-                if ((LLVMGetOperand(ins, 1) == LLVMGetOperand(store_ins, 1)) && (ins != store_ins) ) { // so that all the others are added
-                    block_kill_set.insert(store_ins);
-                }
-            }
+void compute_kill_set_for_block(const struct function_snapshot &snapshot, unsigned block, uint64_t *kill_set) {
+    scoped_pass_timer timer("compute_kill_set_for_block");
+    for (unsigned ins = snapshot.block_start[block]; ins < snapshot.block_start[block + 1]; ins++) {
+        unsigned store = snapshot.store_number[ins];
+        // every pointer is handled once, at the first store of the block to it
+        if (store == SNAPSHOT_NO_INDEX) {
+            continue;
         }
-    }
-    return block_kill_set;
-}
-
-// Getting the predecessors map where the keys are the blocks and the values are their corresponding predecessors
-std::unordered_map <LLVMBasicBlockRef, std::unordered_set <LLVMBasicBlockRef>> compute_predecesor_blocks (LLVMValueRef func) {
-    std::unordered_map <LLVMBasicBlockRef, std::unordered_set <LLVMBasicBlockRef>> predecessors_map;
-
-    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb); // getting the terminator to access the successors
-        if (terminator == NULL) {
+        unsigned previous_store = snapshot.previous_store_to_same_pointer[store];
+        if (previous_store != SNAPSHOT_NO_INDEX && snapshot.block_of_instruction[snapshot.store_instruction[previous_store]] == block) {
             continue;
         }
-        unsigned successor_index = 0;
-        while (successor_index < LLVMGetNumSuccessors(terminator)) {
-            LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, successor_index);
-            predecessors_map[successor].insert(bb); // because the successor's predecessor is the current block
-            successor_index++;
+        unsigned pointer = snapshot.memory_pointer[ins];
+        for (unsigned i = snapshot.pointer_store_start[pointer]; i < snapshot.pointer_store_start[pointer + 1]; i++) {
+            set_bit(kill_set, snapshot.pointer_stores[i]);
+        }
+        // a store only kills itself when another store of the block writes to the same pointer
+        unsigned next_store = snapshot.next_store_to_same_pointer[store];
+        if (next_store == SNAPSHOT_NO_INDEX || snapshot.block_of_instruction[snapshot.store_instruction[next_store]] != block) {
+            clear_bit(kill_set, store);
         }
     }
-    return predecessors_map;
 }
 
-std::unordered_map <LLVMBasicBlockRef, struct IN_and_OUT> in_and_out_sets_map(LLVMValueRef func) {
-    // we begin by computing the predecessors for each block for easier later computation
-    std::unordered_map <LLVMBasicBlockRef, std::unordered_set <LLVMBasicBlockRef>> predecessors_map = compute_predecesor_blocks(func);
+struct reaching_definitions in_and_out_sets_map(const struct function_snapshot &snapshot, struct compile_budget_tracker *budget) {
+    scoped_pass_timer timer("in_and_out_sets_map");
+    unsigned number_of_blocks = snapshot.number_of_blocks();
+    struct reaching_definitions sets;
+    sets.words_per_set = words_for_bits(snapshot.number_of_stores());
+    unsigned words = sets.words_per_set;
     // initializing each "in set" as empty and also initializing each "out set" as the gen set
-    std::unordered_map <LLVMBasicBlockRef, struct IN_and_OUT> in_and_out_sets_map;
-
-    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func);
-        bb != NULL;
-        bb = LLVMGetNextBasicBlock(bb)) {
-            std::unordered_set <LLVMValueRef> in_set = {};
-            std::unordered_set <LLVMValueRef> out_set = compute_gen_set_for_block(bb); 
-
-            struct IN_and_OUT IN_and_OUT_element;
-            // we provide the in_set and out_set data to the IN_and_OUT_element
-            IN_and_OUT_element.in_set = in_set;
-            IN_and_OUT_element.out_set = out_set;
-
-            in_and_out_sets_map[bb] = IN_and_OUT_element;
-        } 
+    sets.in_sets.assign((size_t) number_of_blocks * words, 0);
+    sets.out_sets.assign((size_t) number_of_blocks * words, 0);
+
+    // GEN and KILL do not change while the fixed point is computed so they are computed once
+    std::vector<uint64_t> gen_sets((size_t) number_of_blocks * words, 0);
+    std::vector<uint64_t> kill_sets((size_t) number_of_blocks * words, 0);
+    for (unsigned block = 0; block < number_of_blocks; block++) {
+        compute_gen_set_for_block(snapshot, block, gen_sets.data() + (size_t) block * words);
+        compute_kill_set_for_block(snapshot, block, kill_sets.data() + (size_t) block * words);
+    }
+    sets.out_sets = gen_sets;
 
+    std::vector<uint64_t> new_in_set_for_bb(words);
     bool change = true; // in order to stop when we have reached a fixed point
+    unsigned long long rounds_for_this_function = 0;
 
     while (change) {
+        if (budget != NULL && !budget->allows_round(rounds_for_this_function + 1, budget->limits.maximum_dataflow_rounds, "dataflow rounds")) {
+            sets.is_complete = false; // the sets are not the fixed point yet, nothing can be concluded from them
+            break;
+        }
         change = false; // if a change is found this will change to true again
-        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL;  bb = LLVMGetNextBasicBlock(bb)) {
-
-                // GEN and KILL set for block to do OUT[B] = GEN[B] union (in[B] - kill[B])
-                std::unordered_set <LLVMValueRef> gen_set_of_block = compute_gen_set_for_block(bb);
-                std::unordered_set <LLVMValueRef> kill_set_of_block = compute_kill_set_for_block(bb);
-
-                std::unordered_set <LLVMBasicBlockRef> predecessors_of_bb = predecessors_map[bb];
-
-                // Storing the latest OUT and IN of the block to compare with the new one and see if change has ocurred
-                std::unordered_set <LLVMValueRef> latest_in_set_for_bb = in_and_out_sets_map[bb].in_set;
-                std::unordered_set <LLVMValueRef> latest_out_set_for_bb = in_and_out_sets_map[bb].out_set;
-
-                // We consider the new sets that will be constructed and keep the latest as above for comparison purposes (the new ones have to be cleared to be filled per each cycle)
-                std::unordered_set <LLVMValueRef> new_in_set_for_bb = {};
-                std::unordered_set <LLVMValueRef> new_out_set_for_bb = {};
-
-                // computing and storing IN[B] as the union of the predecessors OUT
-                for (LLVMBasicBlockRef predecessor : predecessors_of_bb) {
-                    new_in_set_for_bb.insert(in_and_out_sets_map[predecessor].out_set.begin(), in_and_out_sets_map[predecessor].out_set.end());
+        rounds_for_this_function++;
+        for (unsigned block = 0; block < number_of_blocks; block++) {
+            uint64_t *in_set = sets.in_set(block);
+            uint64_t *out_set = sets.out_set(block);
+            const uint64_t *gen_set = gen_sets.data() + (size_t) block * words;
+            const uint64_t *kill_set = kill_sets.data() + (size_t) block * words;
+
+            // computing IN[B] as the union of the predecessors OUT
+            std::fill(new_in_set_for_bb.begin(), new_in_set_for_bb.end(), 0);
+            for (unsigned edge = snapshot.predecessor_start[block]; edge < snapshot.predecessor_start[block + 1]; edge++) {
+                const uint64_t *predecessor_out_set = sets.out_set(snapshot.predecessors[edge]);
+                for (unsigned word = 0; word < words; word++) {
+                    new_in_set_for_bb[word] |= predecessor_out_set[word];
                 }
+            }
 
-                // first we include all the gen set elements associated
-                new_out_set_for_bb.insert(gen_set_of_block.begin(), gen_set_of_block.end());
-
-                // inserting IN[B] - KILL[B] to finish defining OUT[B]
-                for (LLVMValueRef IN_instruction : new_in_set_for_bb) {
-                    if (kill_set_of_block.find(IN_instruction) == kill_set_of_block.end()) {// if IN_instruction is not found then it returns kill.end() so we add it (set difference) 
-                            new_out_set_for_bb.insert(IN_instruction);
-                    }
-                }
-
-                // checking if a change has occured
-
-                if ((latest_in_set_for_bb != new_in_set_for_bb) || (latest_out_set_for_bb != new_out_set_for_bb)) {
+            // OUT[B] = GEN[B] union (IN[B] - KILL[B]), written in place while checking if a change has occured
+            for (unsigned word = 0; word < words; word++) {
+                uint64_t new_out_word = gen_set[word] | (new_in_set_for_bb[word] & ~kill_set[word]);
+                if (in_set[word] != new_in_set_for_bb[word] || out_set[word] != new_out_word) {
                     change = true;
-                    in_and_out_sets_map[bb].in_set = new_in_set_for_bb;
-                    in_and_out_sets_map[bb].out_set = new_out_set_for_bb;
+                    in_set[word] = new_in_set_for_bb[word];
+                    out_set[word] = new_out_word;
                 }
             }
+        }
     }
-    return in_and_out_sets_map;
+    fixed_point_rounds += rounds_for_this_function;
+    most_fixed_point_rounds.record_maximum(rounds_for_this_function);
+    return sets;
 }
 
-bool taking_load_into_consideration(LLVMValueRef func){
-    std::unordered_map <LLVMBasicBlockRef, struct IN_and_OUT> in_set_and_out_set_map = in_and_out_sets_map(func);
+// the function is analyses.func, the parameter only gives the signature of a pipeline_pass
+bool taking_load_into_consideration(LLVMValueRef, struct function_analysis_manager &analyses){
+    scoped_pass_timer timer("taking_load_into_consideration");
+    // the analyses read the snapshot and the replacements are written back through the C API
+    const struct function_snapshot &snapshot = analyses.get_snapshot();
+    const struct reaching_definitions &in_set_and_out_set_map = analyses.get_reaching_definitions();
+    if (!in_set_and_out_set_map.is_complete) { // out of budget
+        return false;
+    }
     bool change_has_ocurred = false; // if we perform constant propagation and effectively certain load instructions are liminated then we notify to the caller that a change has happened
-    
-    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
-        
-        std::unordered_set <LLVMValueRef> R = in_set_and_out_set_map[bb].in_set;
-        // filled in the loop for instructions
-        std::unordered_set <LLVMValueRef> marked_load_instructions_to_delete = {};
-        
-        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
 
-            if (LLVMGetInstructionOpcode(ins) == LLVMStore){
+    // a store of a load replaced earlier in this walk stores that constant from now on, the
+    // snapshot was taken before the replacement so the constant is remembered here
+    std::vector<unsigned char> load_was_replaced(snapshot.instructions.size(), 0);
+    std::vector<long long> replacing_constant(snapshot.instructions.size(), 0);
+    std::vector<uint64_t> R(in_set_and_out_set_map.words_per_set);
 
-                R.insert(ins);
+    for (unsigned block = 0; block < snapshot.number_of_blocks(); block++) {
 
-                // variable created just for the purpose of identifying which instruction to erase
-                std::unordered_set <LLVMValueRef> to_erase = {};
+        std::copy(in_set_and_out_set_map.in_set(block), in_set_and_out_set_map.in_set(block) + R.size(), R.begin());
+        // filled in the loop for instructions
+        std::vector<LLVMValueRef> marked_load_instructions_to_delete;
 
-                for (LLVMValueRef ins_in_R : R) {
-                    
-                    bool refers_to_the_same_ptr = (LLVMGetOperand(ins, 1) == LLVMGetOperand(ins_in_R, 1));
-                    bool is_different_from_ins = (ins != ins_in_R);
-                    
-                    if (refers_to_the_same_ptr && is_different_from_ins) {
-                        to_erase.insert(ins_in_R);
-                    }
-                }
+        for (unsigned ins = snapshot.block_start[block]; ins < snapshot.block_start[block + 1]; ins++) {
+            unsigned pointer = snapshot.memory_pointer[ins];
 
-                // we now delete the killed instructions from R
-                for (LLVMValueRef ins_to_erase_from_R : to_erase) {
-                    R.erase(ins_to_erase_from_R); 
+            if (snapshot.opcodes[ins] == LLVMStore){
+                // the other stores to the same pointer are killed and this one reaches
+                for (unsigned i = snapshot.pointer_store_start[pointer]; i < snapshot.pointer_store_start[pointer + 1]; i++) {
+                    clear_bit(R.data(), snapshot.pointer_stores[i]);
                 }
+                set_bit(R.data(), snapshot.store_number[ins]);
             }
 
-            if (LLVMGetInstructionOpcode(ins) == LLVMLoad) {
-                LLVMValueRef ptr = LLVMGetOperand(ins, 0);
-
-                // finding all store instructions in R that write to the ptr
-                std::unordered_set <LLVMValueRef> ins_in_R_to_ptr = {};
-
-                for (LLVMValueRef ins_in_R : R) {
-                    if (LLVMGetOperand(ins_in_R, 1) == ptr) {
-                        ins_in_R_to_ptr.insert(ins_in_R);
-                    }
-                }
-
-                // checking if all of the instructions in R to ptr are the same constant and if they are constant store instructions
-
+            // the stores that reach are not the only writes when a call may write the pointer
+            if (snapshot.opcodes[ins] == LLVMLoad && !snapshot.pointer_may_be_written_by_call[pointer]) {
+                // checking if all of the store instructions in R to ptr are the same constant and if they are constant store instructions
                 bool are_all_the_same_constant = true; // becomes false if we find a counterexample
                 bool is_current_constant_initialized = false;
-                long long current_constant;
-
-                if (!ins_in_R_to_ptr.empty()) {
-
-                    for (LLVMValueRef ins_to_check : ins_in_R_to_ptr) {
-                        LLVMValueRef associated_value = LLVMGetOperand(ins_to_check, 0);
-                        if (!LLVMIsAConstantInt(associated_value)){
-                            are_all_the_same_constant = false; // it is not a constant store instruction so it becomes false
-                            break;
-                        }
-                        if (!is_current_constant_initialized){
-                            current_constant = LLVMConstIntGetSExtValue(associated_value); // to start checking
-                            is_current_constant_initialized = true;
-                        } else {
-                            // they are compared as long long to avoid pointer comparison
-                            if (current_constant != LLVMConstIntGetSExtValue(associated_value)) {
-                                are_all_the_same_constant = false; // we found a counter example where the constant is not the same
-                                break;
-                            }
-                        }
+                long long current_constant = 0;
+
+                for (unsigned i = snapshot.pointer_store_start[pointer]; i < snapshot.pointer_store_start[pointer + 1]; i++) {
+                    unsigned store = snapshot.pointer_stores[i];
+                    if (!test_bit(R.data(), store)) {
+                        continue;
+                    }
+                    unsigned value_instruction = snapshot.stored_value_instruction[store];
+                    bool stores_a_constant = snapshot.stored_value_is_constant_int[store] ||
+                                             (value_instruction != SNAPSHOT_NO_INDEX && load_was_replaced[value_instruction]);
+                    if (!stores_a_constant) {
+                        are_all_the_same_constant = false; // it is not a constant store instruction so it becomes false
+                        break;
+                    }
+                    long long stored_constant = snapshot.stored_value_is_constant_int[store] ? snapshot.stored_constant[store] : replacing_constant[value_instruction];
+                    if (!is_current_constant_initialized){
+                        current_constant = stored_constant; // to start checking
+                        is_current_constant_initialized = true;
+                    } else if (current_constant != stored_constant) {
+                        are_all_the_same_constant = false; // we found a counter example where the constant is not the same
+                        break;
                     }
                 }
 
                 if(are_all_the_same_constant && is_current_constant_initialized) {
                     // converting long long current_constant back to LLVMValueRef to apply LLVMReplaceAllUsesWith
-                    LLVMTypeRef Ty = LLVMTypeOf(ins); // to get the type of integer the load instruction refers to like i32
+                    LLVMValueRef load = snapshot.instructions[ins];
+                    LLVMTypeRef Ty = LLVMTypeOf(load); // to get the type of integer the load instruction refers to like i32
                     LLVMValueRef current_constant_value = LLVMConstInt(Ty, (unsigned long long) current_constant, 1);
-                    LLVMReplaceAllUsesWith(ins, current_constant_value);
+                    LLVMReplaceAllUsesWith(load, current_constant_value);
+                    load_was_replaced[ins] = 1;
+                    replacing_constant[ins] = LLVMConstIntGetSExtValue(current_constant_value);
                     change_has_ocurred = true;
-                    marked_load_instructions_to_delete.insert(ins); // since it was already substituted by current_constant_value
+                    loads_forwarded++;
+                    marked_load_instructions_to_delete.push_back(load); // since it was already substituted by current_constant_value
                 }
             }
         }
-        
+
         for (LLVMValueRef load_to_delete : marked_load_instructions_to_delete) {
             LLVMInstructionEraseFromParent(load_to_delete);
         }
@@ -508,11 +453,18 @@ bool taking_load_into_consideration(LLVMValueRef func){
     return change_has_ocurred;
 }
 
-void constant_propagation_and_constant_folding(LLVMValueRef func) {
+bool constant_propagation_and_constant_folding(LLVMValueRef func, struct function_analysis_manager &analyses) {
+    scoped_pass_timer timer("constant_propagation_and_constant_folding");
+    bool has_changed_at_all = false; // returned so callers know if the function changed
     bool there_is_a_change = true; // becomes true when we encounter one, this boolean is useful to detect if we have reached a fixed point
+    unsigned long long rounds_for_this_function = 0;
     while (there_is_a_change) {
+        if (!analyses.budget.allows_round(rounds_for_this_function + 1, analyses.budget.limits.maximum_fixed_point_rounds, "fixed-point rounds")) {
+            break; // the function is valid after every round, the caller falls back to the local passes
+        }
+        rounds_for_this_function++;
         // constant propagation and then constant folding
-        bool change_of_type_1_occurred = taking_load_into_consideration(func);
+        bool change_of_type_1_occurred = taking_load_into_consideration(func, analyses);
         bool change_of_type_2_occurred = false; // gets updated based on the following loop
         for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
             if (run_constant_folding(bb)) { // run_constant_folding returns true if there has been a change and false otherwise
@@ -521,7 +473,21 @@ void constant_propagation_and_constant_folding(LLVMValueRef func) {
         }
         if (!change_of_type_1_occurred && !change_of_type_2_occurred) { // no change happened then we are done
             there_is_a_change = false;
+        } else {
+            has_changed_at_all = true;
+            // loads were forwarded or arithmetic folded, the stores and the edges are the same
+            analyses.invalidate(ANALYSIS_REACHING_DEFINITIONS);
         }
     }
-    run_dead_code_elimination(func); // in case we have dead code afterwards
-}
\ No newline at end of file
+    propagation_rounds += rounds_for_this_function;
+    most_propagation_rounds.record_maximum(rounds_for_this_function);
+    if (run_dead_code_elimination(func)) { // in case we have dead code afterwards
+        has_changed_at_all = true;
+    }
+    return has_changed_at_all;
+}
+
+bool constant_propagation_and_constant_folding(LLVMValueRef func) {
+    struct function_analysis_manager analyses(func);
+    return constant_propagation_and_constant_folding(func, analyses);
+}
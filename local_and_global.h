@@ -0,0 +1,48 @@
+#ifndef LOCAL_AND_GLOBAL_H
+#define LOCAL_AND_GLOBAL_H
+
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+#include <unordered_set>
+#include <unordered_map>
+#include <stdint.h>
+#include <vector>
+#include "flat_pointer_hash.h"
+#include "function_snapshot.h"
+
+// IN and OUT of every block as bit vectors over the store numbers of a function_snapshot
+struct reaching_definitions {
+    unsigned words_per_set;
+    std::vector<uint64_t> in_sets;  // the IN of block b is words [b * words_per_set, (b + 1) * words_per_set)
+    std::vector<uint64_t> out_sets;
+    bool is_complete = true; // false when the compile budget stopped the fixed point early
+
+    uint64_t *in_set(unsigned block) { return in_sets.data() + (size_t) block * words_per_set; }
+    uint64_t *out_set(unsigned block) { return out_sets.data() + (size_t) block * words_per_set; }
+    const uint64_t *in_set(unsigned block) const { return in_sets.data() + (size_t) block * words_per_set; }
+    const uint64_t *out_set(unsigned block) const { return out_sets.data() + (size_t) block * words_per_set; }
+};
+
+struct function_analysis_manager;
+struct compile_budget_tracker;
+
+// local optimizations
+bool run_common_subexpression_elimination(LLVMBasicBlockRef bb);
+bool run_constant_folding(LLVMBasicBlockRef bb);
+bool run_dead_code_elimination(LLVMValueRef func);
+bool is_store_in_between_shared_memory_uses(LLVMValueRef first_instruction, LLVMValueRef second_instruction);
+bool instruction_should_be_kept(LLVMValueRef instruction);
+
+// global optimizations (reaching definitions based constant propagation)
+// (the analyses run on a function_snapshot, the sets are filled in as bit vectors of store numbers)
+// No pass adds, removes or moves a store, block or edge, so they all preserve the reaching
+// definitions cached by a function_analysis_manager. The passes taking one leave invalidating it
+// to their caller; the version without one uses a manager of its own.
+void compute_gen_set_for_block(const struct function_snapshot &snapshot, unsigned block, uint64_t *gen_set);
+void compute_kill_set_for_block(const struct function_snapshot &snapshot, unsigned block, uint64_t *kill_set);
+struct reaching_definitions in_and_out_sets_map(const struct function_snapshot &snapshot, struct compile_budget_tracker *budget = NULL);
+bool taking_load_into_consideration(LLVMValueRef func, struct function_analysis_manager &analyses);
+bool constant_propagation_and_constant_folding(LLVMValueRef func, struct function_analysis_manager &analyses);
+bool constant_propagation_and_constant_folding(LLVMValueRef func);
+
+#endif
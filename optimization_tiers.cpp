@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <mutex>
+#include "optimization_tiers.h"
+#include "latency_statistics.h"
+#include "pass_pipeline.h"
+
+static const char *tier_names[NUMBER_OF_OPTIMIZATION_TIERS] = {"tier 0", "tier 1", "tier 0 to 1"};
+
+static std::mutex latencies_lock;
+static struct latency_samples latencies[NUMBER_OF_OPTIMIZATION_TIERS];
+
+static void record_tier_latency(enum optimization_tier tier, double elapsed_ms) {
+    std::lock_guard<std::mutex> guard(latencies_lock);
+    record_latency_sample(latencies[tier], elapsed_ms);
+}
+
+static const struct pass_pipeline &tier_pipeline(enum optimization_tier tier) {
+    static const struct pass_pipeline pipelines[NUMBER_OF_OPTIMIZATION_TIERS] = {
+        built_in_pass_pipeline(PIPELINE_TIER_0),
+        built_in_pass_pipeline(PIPELINE_TIER_1),
+        built_in_pass_pipeline(PIPELINE_TIER_0_TO_1),
+    };
+    return pipelines[tier];
+}
+
+static struct optimizer_stats optimize_with_tier_pipeline(LLVMValueRef function, enum optimization_tier tier,
+                                                          const struct optimizer_options &options) {
+    struct optimizer_options tier_options = options;
+    tier_options.pipeline = &tier_pipeline(tier);
+    struct optimizer_stats stats = optimize(function, tier_options);
+    if (stats.functions_optimized > 0) {
+        record_tier_latency(tier, stats.elapsed_ms);
+    }
+    return stats;
+}
+
+struct optimizer_stats optimize_at_tier(LLVMValueRef function, enum optimization_tier tier, const struct optimizer_options &options) {
+    return optimize_with_tier_pipeline(function, tier == OPTIMIZATION_TIER_0 ? OPTIMIZATION_TIER_0 : OPTIMIZATION_TIER_1, options);
+}
+
+struct optimizer_stats promote_to_tier_1(LLVMValueRef function, const struct optimizer_options &options) {
+    return optimize_with_tier_pipeline(function, OPTIMIZATION_TIER_0_TO_1, options);
+}
+
+void print_tier_latency_report(FILE *output) {
+    std::lock_guard<std::mutex> guard(latencies_lock);
+    fprintf(output, "===== Optimization latency per tier (ms per function) =====\n");
+    fprintf(output, "  %-12s %10s %10s %10s %10s %10s\n", "tier", "functions", "mean", "p50", "p99", "max");
+    for (int tier = 0; tier < NUMBER_OF_OPTIMIZATION_TIERS; tier++) {
+        struct latency_summary summary = summarize_latency_samples(latencies[tier]);
+        fprintf(output, "  %-12s %10llu %10.3f %10.3f %10.3f %10.3f\n", tier_names[tier], latencies[tier].count, summary.mean_ms,
+                summary.p50_ms, summary.p99_ms, summary.max_ms);
+    }
+}
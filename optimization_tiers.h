@@ -0,0 +1,39 @@
+#ifndef OPTIMIZATION_TIERS_H
+#define OPTIMIZATION_TIERS_H
+
+#include <stdio.h>
+#include <llvm-c/Core.h>
+#include "optimizer.h"
+
+// Tiered optimization for a JIT
+//
+// Latency to the first execution matters more than the quality of code that runs once. Tier 0
+// runs the local passes only, each linear in the size of the function. Tier 1 is the default
+// pipeline, which adds the reaching definitions based propagation. A function optimized at tier 0
+// that turns out to be hot is promoted in place, in the module the JIT already holds: only the
+// passes tier 1 adds run, and the result is the same as optimizing the original at tier 1.
+// Every call records its latency, and print_tier_latency_report shows them per tier so the
+// promotion thresholds can be tuned.
+
+#define PIPELINE_TIER_0 PIPELINE_O1
+#define PIPELINE_TIER_1 PIPELINE_O2
+#define PIPELINE_TIER_0_TO_1 "global-constant-propagation" // what PIPELINE_TIER_1 runs after PIPELINE_TIER_0
+
+enum optimization_tier {
+    OPTIMIZATION_TIER_0,
+    OPTIMIZATION_TIER_1,
+    OPTIMIZATION_TIER_0_TO_1, // a promotion, reported apart from the direct tier 1 compiles
+    NUMBER_OF_OPTIMIZATION_TIERS
+};
+
+// tier is OPTIMIZATION_TIER_0 or OPTIMIZATION_TIER_1, options.pipeline is ignored
+struct optimizer_stats optimize_at_tier(LLVMValueRef function, enum optimization_tier tier,
+                                        const struct optimizer_options &options = optimizer_options());
+
+// function must have been optimized at tier 0 and not changed since
+struct optimizer_stats promote_to_tier_1(LLVMValueRef function, const struct optimizer_options &options = optimizer_options());
+
+// number of functions, mean, p50, p99 and max latency in ms of each tier
+void print_tier_latency_report(FILE *output);
+
+#endif
@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <string.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <string>
+#include <vector>
+#include "optimizer.h"
+#include "local_and_global.h"
+#include "function_cache.h"
+#include "function_transfer.h"
+#include "function_attributes.h"
+#include "function_arena.h"
+#include "function_analysis_manager.h"
+#include "call_graph.h"
+#include "scc_scheduler.h"
+#include "inliner.h"
+#include "interprocedural_constant_propagation.h"
+#include "function_specialization.h"
+#include "link_time_optimization.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(functions_optimized, "driver", "Number of functions that went through the passes");
+
+OPTIMIZER_STATISTIC(functions_degraded, "driver", "Number of functions that ran out of compile budget and only got the local passes");
+OPTIMIZER_STATISTIC(functions_interrupted, "driver", "Number of functions stopped part way by a cancellation or a deadline");
+
+static unsigned long long count_instructions(LLVMValueRef func) {
+    unsigned long long instructions = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            instructions++;
+        }
+    }
+    return instructions;
+}
+
+static unsigned long long count_stores(LLVMValueRef func) {
+    unsigned long long stores = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef ins = LLVMGetFirstInstruction(bb); ins != NULL; ins = LLVMGetNextInstruction(ins)) {
+            stores += LLVMGetInstructionOpcode(ins) == LLVMStore;
+        }
+    }
+    return stores;
+}
+
+static const struct pass_pipeline &default_pipeline() {
+    static const struct pass_pipeline pipeline = built_in_pass_pipeline(DEFAULT_PASS_CONFIGURATION);
+    return pipeline;
+}
+
+static const struct pass_pipeline &degraded_pipeline() {
+    static const struct pass_pipeline pipeline = built_in_pass_pipeline(PIPELINE_DEGRADED);
+    return pipeline;
+}
+
+// the pass sequence, shared by every caller of the library. Returns the budget tracker of the
+// function, whose exceeded_limit is NULL when it got the whole pipeline.
+static struct compile_budget_tracker run_passes(LLVMValueRef func, const struct optimizer_options &options) {
+    scoped_pass_timer timer("optimize_function");
+    functions_optimized++;
+    // the analysis_set and analysis_map tables of the passes live in the arena, which is reset when
+    // the function is done (function_arena.h tells what stays on the heap)
+    function_arena_scope arena_scope;
+    struct function_analysis_manager analyses(func);
+    analyses.budget.limits = options.budget;
+    analyses.budget.start_ns = pass_timing_now_ns();
+    analyses.budget.cancellation = options.cancellation;
+    analyses.budget.deadline_ns = options.deadline_ns;
+    if (options.budget.maximum_instructions != 0 && count_instructions(func) > options.budget.maximum_instructions) {
+        analyses.budget.exceeded_limit = "instructions";
+    } else if (options.budget.maximum_stores != 0 && count_stores(func) > options.budget.maximum_stores) {
+        analyses.budget.exceeded_limit = "stores";
+    } else {
+        run_pass_pipeline(options.pipeline != NULL ? *options.pipeline : default_pipeline(), analyses);
+    }
+    if (analyses.budget.exceeded_limit == NULL) {
+        return analyses.budget;
+    }
+    if (analyses.budget.was_interrupted) { // the caller wants its thread back, nothing else runs
+        functions_interrupted++;
+        return analyses.budget;
+    }
+    // whatever the pipeline did is kept, the linear passes run without limits
+    functions_degraded++;
+    struct function_analysis_manager degraded_analyses(func);
+    run_pass_pipeline(degraded_pipeline(), degraded_analyses);
+    return analyses.budget;
+}
+
+// OPTIMIZER_COMPLETED unless tracker was interrupted
+static enum optimizer_status interruption_status(const struct compile_budget_tracker &tracker) {
+    if (!tracker.was_interrupted) {
+        return OPTIMIZER_COMPLETED;
+    }
+    return strcmp(tracker.exceeded_limit, "cancellation") == 0 ? OPTIMIZER_CANCELLED : OPTIMIZER_DEADLINE_EXCEEDED;
+}
+
+// counts what happened to a function that went through run_passes, true if it got the whole pipeline
+static bool record_outcome(struct optimizer_stats &stats, LLVMValueRef func, const struct compile_budget_tracker &outcome) {
+    if (outcome.was_interrupted) {
+        stats.status = interruption_status(outcome);
+        stats.functions_interrupted++;
+        return false;
+    }
+    if (outcome.exceeded_limit != NULL) {
+        size_t name_length;
+        const char *name = LLVMGetValueName2(func, &name_length);
+        stats.functions_degraded++;
+        stats.degraded_functions.push_back(std::string(name, name_length) + " (" + outcome.exceeded_limit + " limit)");
+        return false;
+    }
+    return true;
+}
+
+struct optimizer_stats optimize(LLVMValueRef function, const struct optimizer_options &options) {
+    struct optimizer_stats stats;
+    if (LLVMCountBasicBlocks(function) == 0) { // there is nothing to process
+        return stats;
+    }
+    long long start_ns = pass_timing_now_ns();
+    stats.instructions_before = count_instructions(function);
+    record_outcome(stats, function, run_passes(function, options));
+    stats.functions_optimized = 1;
+    stats.instructions_after = count_instructions(function);
+    stats.elapsed_ms = (pass_timing_now_ns() - start_ns) / 1e6;
+    return stats;
+}
+
+// a function the pipeline runs on after its inlining and cache lookup
+struct pending_function {
+    LLVMValueRef func;
+    struct function_cache_key key;
+    bool is_cacheable;
+    int job; // index into the jobs of its component, -1 when the calling thread optimizes it
+};
+
+// a function optimized by a worker thread, in an LLVM context of its own
+struct function_job {
+    std::string name;
+    std::string text; // the standalone module of function_transfer.h
+    bool was_started = false;
+    std::string optimized_body; // empty if the text did not parse
+    struct compile_budget_tracker outcome;
+};
+
+// what optimize(module) keeps per component of the call graph between its start and its finish
+struct scheduled_optimization {
+    const struct optimizer_options &options;
+    const struct call_graph &graph;
+    struct compile_budget_tracker &call;
+    struct optimizer_stats &stats;
+    std::vector<std::vector<struct pending_function>> pending_of_scc;
+    std::vector<std::vector<struct function_job>> jobs_of_scc;
+};
+
+// the context a worker thread parses its jobs into, created for its first job and released when
+// the thread ends
+struct worker_context {
+    LLVMContextRef context = NULL;
+    ~worker_context() {
+        if (context != NULL) LLVMContextDispose(context);
+    }
+};
+
+static thread_local struct worker_context thread_context;
+
+static void run_function_job(struct function_job &job, const struct optimizer_options &options) {
+    if (thread_context.context == NULL) {
+        thread_context.context = LLVMContextCreate();
+    }
+    LLVMContextRef context = thread_context.context;
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(job.text.data(), job.text.size(), job.name.c_str());
+    LLVMModuleRef module = NULL;
+    char *err_message = NULL;
+    if (LLVMParseIRInContext(context, buffer, &module, &err_message)) { // the parser owns the buffer
+        if (err_message != NULL) LLVMDisposeMessage(err_message);
+        if (module != NULL) LLVMDisposeModule(module);
+        return;
+    }
+    LLVMValueRef func = LLVMGetNamedFunction(module, TRANSFERRED_FUNCTION_NAME);
+    pass_timing_begin_function(job.name.c_str());
+    job.outcome = run_passes(func, options);
+    pass_timing_end_function();
+    job.optimized_body = print_function_body(func);
+    LLVMDisposeModule(module);
+}
+
+// the optimized body of a pending function, then the outcome counted and the body cached
+static void finish_function(const struct pending_function &pending, const struct compile_budget_tracker &outcome,
+                            const struct optimizer_options &options, struct optimizer_stats &stats) {
+    stats.functions_optimized++;
+    // a partial or degraded body is not what the pipeline gives, so it is not cached
+    if (record_outcome(stats, pending.func, outcome) && pending.is_cacheable) {
+        function_cache_insert(options.cache, pending.key, pending.func);
+    }
+    stats.instructions_after += count_instructions(pending.func);
+}
+
+// counts a function left as it was because the call had already stopped, instructions_before
+// included when it was not counted yet
+static void skip_function(LLVMValueRef func, bool was_counted, struct optimizer_stats &stats) {
+    unsigned long long instructions = count_instructions(func);
+    stats.instructions_before += was_counted ? 0 : instructions;
+    stats.instructions_after += instructions;
+    stats.functions_not_started++;
+}
+
+// true once the cancellation or the deadline stopped the call, which is then recorded in stats
+static bool has_stopped(struct compile_budget_tracker &call, struct optimizer_stats &stats) {
+    if (stats.status == OPTIMIZER_COMPLETED && call.is_exhausted()) {
+        stats.status = interruption_status(call);
+    }
+    return stats.status != OPTIMIZER_COMPLETED;
+}
+
+// inlines into the functions of the component and looks them up in the cache, the ones left to
+// optimize are handed to the workers when they can be moved as text
+static void start_component(struct scheduled_optimization &state, unsigned scc, std::vector<scc_task> &tasks) {
+    const struct optimizer_options &options = state.options;
+    struct optimizer_stats &stats = state.stats;
+    std::vector<struct pending_function> &pending = state.pending_of_scc[scc];
+    std::vector<struct function_job> &jobs = state.jobs_of_scc[scc];
+    for (unsigned function_index : state.graph.sccs[scc]) {
+        LLVMValueRef func = state.graph.functions[function_index];
+        if (has_stopped(state.call, stats)) {
+            skip_function(func, false, stats);
+            continue;
+        }
+        size_t name_length;
+        const char *name = LLVMGetValueName2(func, &name_length);
+        pass_timing_begin_function(name);
+        stats.instructions_before += count_instructions(func);
+        if (options.inline_threshold != 0) {
+            // the cache key is taken after inlining, it covers the inlined bodies too
+            stats.calls_inlined += inline_calls(func, state.graph, options.inline_threshold, options.budget.maximum_instructions);
+        }
+        struct pending_function function = {func, {0, 0}, false, -1};
+        bool was_spliced = false;
+        if (options.cache != NULL) {
+            scoped_pass_timer timer("function_cache_lookup");
+            function.is_cacheable = function_cache_compute_key(options.cache, func, &function.key);
+            was_spliced = function.is_cacheable && function_cache_splice_if_present(options.cache, function.key, func);
+        }
+        if (was_spliced) {
+            stats.functions_from_cache++;
+            stats.instructions_after += count_instructions(func);
+        } else {
+            struct function_job job;
+            if (options.number_of_threads > 1 && function_body_is_transferable(func)) {
+                std::string body = print_function_body(func);
+                if (build_standalone_function_text(func, body.data(), body.size(), job.text)) {
+                    job.name.assign(name, name_length);
+                    function.job = jobs.size();
+                    jobs.push_back(job);
+                }
+            }
+            pending.push_back(function);
+        }
+        pass_timing_end_function();
+    }
+    // jobs is complete, its elements no longer move
+    for (struct function_job &job : jobs) {
+        struct compile_budget_tracker worker_call = state.call; // each task checks a copy of its own
+        tasks.push_back([&job, &options, worker_call]() mutable {
+            if (worker_call.is_exhausted()) {
+                job.outcome = worker_call;
+                return;
+            }
+            job.was_started = true;
+            run_function_job(job, options);
+        });
+    }
+}
+
+// optimizes the functions that could not be moved and splices the bodies the workers optimized
+static void finish_component(struct scheduled_optimization &state, unsigned scc) {
+    const struct optimizer_options &options = state.options;
+    struct optimizer_stats &stats = state.stats;
+    std::vector<struct function_job> &jobs = state.jobs_of_scc[scc];
+    for (const struct pending_function &function : state.pending_of_scc[scc]) {
+        if (function.job < 0) {
+            if (has_stopped(state.call, stats)) {
+                skip_function(function.func, true, stats);
+                continue;
+            }
+            size_t name_length;
+            pass_timing_begin_function(LLVMGetValueName2(function.func, &name_length));
+            finish_function(function, run_passes(function.func, options), options, stats);
+            pass_timing_end_function();
+            continue;
+        }
+        struct function_job &job = jobs[function.job];
+        if (!job.was_started) {
+            if (stats.status == OPTIMIZER_COMPLETED) {
+                stats.status = interruption_status(job.outcome);
+            }
+            skip_function(function.func, true, stats);
+        } else if (!job.optimized_body.empty() && splice_function_body(function.func, job.optimized_body.data(), job.optimized_body.size())) {
+            finish_function(function, job.outcome, options, stats);
+        } else { // the body did not survive the trip as text, it is optimized here instead
+            pass_timing_begin_function(job.name.c_str());
+            finish_function(function, run_passes(function.func, options), options, stats);
+            pass_timing_end_function();
+        }
+    }
+    state.pending_of_scc[scc].clear();
+    jobs.clear();
+    // once every function of the component is optimized, so their callers see the attributes
+    if (options.attribute_inference && stats.status == OPTIMIZER_COMPLETED) {
+        stats.attributes_inferred += infer_function_attributes(state.graph, scc);
+    }
+}
+
+// optimization is applied per function, when a cache is given a function whose body was seen
+// before gets the stored optimized body and skips every pass. The functions go bottom-up through
+// the call graph (see scc_scheduler.h), so each callee is optimized before it is inlined. With
+// interprocedural constant propagation the module goes back and forth between it and the
+// pipeline until no new constant crosses a call. With attribute inference every component gets
+// the attributes of its optimized bodies before its callers start, so their passes can merge or
+// drop calls that do not write memory. Dead function removal comes last, once inlining and
+// specialization have taken every call they are going to take.
+struct optimizer_stats optimize(LLVMModuleRef module, const struct optimizer_options &options) {
+    struct optimizer_stats stats;
+    long long start_ns = pass_timing_now_ns();
+    // only watches the cancellation and the deadline, between functions
+    struct compile_budget_tracker call;
+    call.cancellation = options.cancellation;
+    call.deadline_ns = options.deadline_ns;
+    if (options.interprocedural_constant_propagation) {
+        // constants passed as they are get in before the functions are first optimized
+        propagate_interprocedural_constants(module);
+    }
+    if (options.specialization_budget != 0) {
+        // the copies are optimized like any other function, with their constants in place
+        stats.specializations = specialize_functions(module, options.specialization_budget,
+                                                     options.interprocedural_constant_propagation).size();
+    }
+    // callees are optimized before their callers, which the inliner needs
+    struct call_graph graph;
+    build_call_graph(module, graph);
+    struct scheduled_optimization state = {options, graph, call, stats, {}, {}};
+    state.pending_of_scc.resize(graph.sccs.size());
+    state.jobs_of_scc.resize(graph.sccs.size());
+    struct scc_schedule schedule;
+    schedule.start = [&state](unsigned scc, std::vector<scc_task> &tasks) { start_component(state, scc, tasks); };
+    schedule.finish = [&state](unsigned scc) { finish_component(state, scc); };
+    run_scc_schedule(graph, options.number_of_threads, schedule);
+    // what the pipeline folded can make more arguments and returns constant, the functions that
+    // got new constants go through the pipeline again
+    bool was_reoptimized = false;
+    for (unsigned long long round = 1; options.interprocedural_constant_propagation && stats.status == OPTIMIZER_COMPLETED; round++) {
+        if (!call.allows_round(round, options.budget.maximum_fixed_point_rounds, "fixed-point rounds")) {
+            stats.status = interruption_status(call);
+            break;
+        }
+        std::vector<LLVMValueRef> changed_functions = propagate_interprocedural_constants(module);
+        if (changed_functions.empty()) {
+            break;
+        }
+        for (LLVMValueRef func : changed_functions) {
+            if (call.is_exhausted()) {
+                stats.status = interruption_status(call);
+                break;
+            }
+            size_t name_length;
+            pass_timing_begin_function(LLVMGetValueName2(func, &name_length));
+            record_outcome(stats, func, run_passes(func, options));
+            pass_timing_end_function();
+            stats.functions_reoptimized++;
+            was_reoptimized = true;
+            if (stats.status != OPTIMIZER_COMPLETED) {
+                break;
+            }
+        }
+    }
+    if (options.dead_function_removal) {
+        stats.functions_removed = remove_dead_functions(module);
+    }
+    if (was_reoptimized || stats.functions_removed != 0) {
+        stats.instructions_after = 0;
+        for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+            stats.instructions_after += count_instructions(func);
+        }
+    }
+    stats.elapsed_ms = (pass_timing_now_ns() - start_ns) / 1e6;
+    return stats;
+}
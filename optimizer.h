@@ -0,0 +1,85 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <llvm-c/Core.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "pass_pipeline.h"
+#include "compile_budget.h"
+
+// In-process interface of the optimizer
+//
+// The passes and their support code build into a library that any program linking LLVM can
+// call; optimizer_cli.cpp, the server and the benchmarks are built on this header. Both calls
+// optimize in place IR the caller owns, in whatever LLVMContext it lives. Threads may optimize
+// at the same time as long as each works in its own context.
+//
+// A call can be abandoned from another thread through options.cancellation, or bounded by
+// options.deadline_ns. Both are checked between rounds and between blocks, never in the middle
+// of rewriting one, so the function being optimized is left valid with whatever the finished
+// rounds did. The functions after it are left as they were and stats.status tells which happened.
+//
+// With options.number_of_threads above one, optimize(module) runs the pipeline of several
+// functions at once. The LLVM context is not thread-safe, so each worker parses the function it
+// was given into a context of its own (see function_transfer.h), optimizes it there, and the
+// optimized body is spliced back by the calling thread. Functions that cannot be moved that way
+// are optimized by the calling thread. A function only starts once all its callees are done (see
+// scc_scheduler.h), so the result is the same for any number of threads.
+
+// part of the function cache key, a new version or pass configuration never reuses old entries
+#define OPTIMIZER_VERSION "1.2"
+#define DEFAULT_PASS_CONFIGURATION PIPELINE_O2
+
+struct function_cache;
+
+struct optimizer_options {
+    struct function_cache *cache = NULL; // optimized bodies are looked up and stored here when set
+    const struct pass_pipeline *pipeline = NULL; // NULL runs DEFAULT_PASS_CONFIGURATION
+    struct compile_budget budget; // per function, no limits by default
+    const std::atomic<bool> *cancellation = NULL; // the call stops soon after it is set to true
+    long long deadline_ns = 0; // for the whole call on the pass_timing_now_ns() clock, 0 for none
+    unsigned inline_threshold = 0; // see inliner.h, 0 inlines nothing. Only optimize(module) inlines.
+    bool interprocedural_constant_propagation = false; // see interprocedural_constant_propagation.h, optimize(module) only
+    unsigned specialization_budget = 0; // see function_specialization.h, 0 specializes nothing. optimize(module) only.
+    bool dead_function_removal = false; // see link_time_optimization.h, optimize(module) only
+    bool attribute_inference = false; // see function_attributes.h, optimize(module) only
+    unsigned number_of_threads = 1; // optimize(module) only, see below
+};
+
+enum optimizer_status {
+    OPTIMIZER_COMPLETED,
+    OPTIMIZER_CANCELLED,
+    OPTIMIZER_DEADLINE_EXCEEDED
+};
+
+// deadline_ns for a call that has to finish within milliseconds from now
+static inline long long optimizer_deadline_after_ms(double milliseconds) {
+    return pass_timing_now_ns() + (long long)(milliseconds * 1e6);
+}
+
+struct optimizer_stats {
+    unsigned functions_optimized = 0;  // went through the passes
+    unsigned functions_from_cache = 0; // got a cached optimized body instead
+    unsigned functions_degraded = 0;   // ran out of budget and finished with PIPELINE_DEGRADED
+    std::vector<std::string> degraded_functions; // "name (limit)" for each of them
+    enum optimizer_status status = OPTIMIZER_COMPLETED;
+    unsigned functions_interrupted = 0; // stopped part way by the cancellation or the deadline
+    unsigned functions_not_started = 0; // left untouched because the call was already stopped
+    unsigned calls_inlined = 0;
+    unsigned specializations = 0; // copies of functions made for constant arguments
+    unsigned functions_reoptimized = 0; // went through the passes again after new constants crossed a call
+    unsigned functions_removed = 0; // internal functions nothing called anymore
+    unsigned attributes_inferred = 0; // memory effects, nounwind and willreturn added to functions
+    unsigned long long instructions_before = 0;
+    unsigned long long instructions_after = 0;
+    double elapsed_ms = 0;
+};
+
+// every function with a body, declarations are left alone
+struct optimizer_stats optimize(LLVMModuleRef module, const struct optimizer_options &options = optimizer_options());
+
+// a single function, a declaration gives empty stats (options.cache is not used)
+struct optimizer_stats optimize(LLVMValueRef function, const struct optimizer_options &options = optimizer_options());
+
+#endif
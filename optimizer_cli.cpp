@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "optimizer.h"
+#include "optimizer_server.h"
+#include "pass_pipeline.h"
+#include "optimization_tiers.h"
+#include "inliner.h"
+#include "function_specialization.h"
+#include "link_time_optimization.h"
+#include "function_cache.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+#include "execution_evaluation.h"
+
+// Command line driver, a thin wrapper around optimize() from optimizer.h
+
+// reads and parses one of the .ll files given, exiting with the error code of the problem found
+static LLVMModuleRef parse_input_file(char *input_file_with_extension, LLVMContextRef context_for_parser) {
+    // to guarantee the user has provided the correct extension
+    int length_of_input_file = strlen(input_file_with_extension);
+    char input_extension[4];
+    int i;
+    int j = 0; //tracks which char of the input_extension we are in
+    if (length_of_input_file < 3) {
+        fprintf(stderr, "%s\n", "You should provide a file with extension .ll therefore the length of the name should be more than 3.");
+        exit(2);
+    }
+    for(i = length_of_input_file - 3; i < length_of_input_file; i++){
+        input_extension[j] = input_file_with_extension[i];
+        j++;
+    }
+    input_extension[j] = '\0';
+    if (strcmp(input_extension, ".ll") != 0) { // if they are not equal incorrect input has been provided
+        fprintf(stderr, "%s\n", "You provided a file with the incorect extension. I t should be .ll");
+        exit(3);
+    }
+    
+    // buffer to store the contents to be parsed
+    LLVMMemoryBufferRef buffer = NULL;
+    char *err_message = NULL;
+    LLVMBool did_fail = LLVMCreateMemoryBufferWithContentsOfFile(input_file_with_extension,
+                                                  &buffer,
+                                                  &err_message);
+    if (did_fail){
+        fprintf(stderr, "%s", err_message);
+        LLVMDisposeMessage(err_message);
+        if (buffer) {
+            LLVMDisposeMemoryBuffer(buffer);
+        }
+        exit(4);
+    }
+
+    
+    // parsing process starts
+    LLVMModuleRef module = NULL; //filled by function
+    LLVMBool parsing_failed = LLVMParseIRInContext(context_for_parser,
+                                         buffer,
+                                         &module,
+                                         &err_message);
+    if (parsing_failed){
+        fprintf(stderr, "%s", err_message);
+        LLVMDisposeMessage(err_message);
+        if (module) {
+            LLVMDisposeModule(module);
+        }
+        LLVMContextDispose(context_for_parser);
+        LLVMDisposeMemoryBuffer(buffer);
+        exit(5);
+    }
+    return module;
+}
+
+// Processes input .ll file and outputs a file with the optimized version
+int main(int argc, char *argv[]){
+    // server mode: ./optimizer_executable --serve <socket_path> [number_of_workers]
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        if (argc != 3 && argc != 4) {
+            fprintf(stderr, "%s\n", "Server mode expects the socket path and optionally the number of workers");
+            exit(1);
+        }
+        int number_of_workers = (argc == 4) ? atoi(argv[3]) : DEFAULT_NUMBER_OF_WORKERS;
+        if (number_of_workers <= 0) {
+            fprintf(stderr, "%s\n", "The number of workers should be a positive integer");
+            exit(1);
+        }
+        return run_optimizer_server(argv[2], number_of_workers);
+    }
+
+    // optional flags come before the path of the .ll file
+    const char *cache_path = NULL;
+    unsigned long long cache_size_limit = FUNCTION_CACHE_DEFAULT_SIZE_LIMIT;
+    const char *timing_json_path = NULL; // with --time-passes alone the report goes to the terminal
+    bool print_timing_report = false;
+    bool print_hardware_counters = false;
+    bool print_statistics = false;
+    const char *statistics_json_path = NULL;
+    bool should_evaluate = false; // run the original and the optimized module instead of printing
+    const char *pipeline_text = DEFAULT_PASS_CONFIGURATION; // -O2 unless -O, --passes or --passes-file says otherwise
+    const char *pipeline_file_path = NULL;
+    struct compile_budget budget; // per function limits, none unless given
+    double deadline_ms = 0; // for the whole optimization, 0 for none
+    unsigned inline_threshold = 0; // no inlining unless --inline or --inline-threshold, or linking
+    bool has_inline_option = false;
+    bool should_propagate_across_calls = false; // --ipcp
+    bool should_infer_attributes = false; // --infer-attributes, or linking
+    unsigned specialization_budget = 0; // no specialization unless --specialize or --specialization-budget
+    std::vector<std::string> exported_names(1, "main"); // the functions other modules may call, when linking
+    unsigned number_of_threads = 0; // one, or every core when linking, unless --threads
+    bool is_tiered = false; // tier 0 for every function and then the promotion to tier 1, as a JIT would
+    struct evaluation_options evaluation;
+    evaluation.entry_function_name = NULL;
+    int argument_index = 1;
+    while (argument_index < argc - 1 && argv[argument_index][0] == '-') {
+        if (strncmp(argv[argument_index], "-O", 2) == 0 && pass_pipeline_preset(argv[argument_index] + 2) != NULL) {
+            pipeline_text = pass_pipeline_preset(argv[argument_index] + 2);
+            pipeline_file_path = NULL;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--tiered") == 0) {
+            is_tiered = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--inline") == 0) {
+            inline_threshold = INLINE_DEFAULT_THRESHOLD;
+            has_inline_option = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--inline-threshold") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            inline_threshold = atoi(argv[argument_index + 1]);
+            has_inline_option = true;
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--no-inline") == 0) {
+            inline_threshold = 0;
+            has_inline_option = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--export") == 0) {
+            exported_names.push_back(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--threads") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            number_of_threads = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--ipcp") == 0) {
+            should_propagate_across_calls = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--infer-attributes") == 0) {
+            should_infer_attributes = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--specialize") == 0) {
+            specialization_budget = SPECIALIZATION_DEFAULT_BUDGET;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--specialization-budget") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            specialization_budget = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--passes") == 0) {
+            pipeline_text = argv[argument_index + 1];
+            pipeline_file_path = NULL;
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--passes-file") == 0) {
+            pipeline_file_path = argv[argument_index + 1];
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--cache") == 0) {
+            cache_path = argv[argument_index + 1];
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--time-passes") == 0) {
+            pass_timing_enabled = true;
+            print_timing_report = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--perf-counters") == 0) {
+            // the counters are read by the pass timers, so they need the timing to be on
+            pass_timing_enabled = true;
+            print_hardware_counters = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--time-passes-json") == 0) {
+            pass_timing_enabled = true;
+            timing_json_path = argv[argument_index + 1];
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--stats") == 0) {
+            print_statistics = true;
+            argument_index += 1;
+        } else if (strcmp(argv[argument_index], "--stats-json") == 0) {
+            statistics_json_path = argv[argument_index + 1];
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--evaluate") == 0) {
+            should_evaluate = true;
+            evaluation.entry_function_name = argv[argument_index + 1];
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--evaluate-args") == 0 && parse_integer_list(argv[argument_index + 1], evaluation.entry_arguments)) {
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--evaluate-input") == 0 && parse_integer_list(argv[argument_index + 1], evaluation.read_values)) {
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--max-instructions") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            budget.maximum_instructions = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--max-stores") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            budget.maximum_stores = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--max-dataflow-rounds") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            budget.maximum_dataflow_rounds = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--max-fixed-point-rounds") == 0 && atoi(argv[argument_index + 1]) > 0) {
+            budget.maximum_fixed_point_rounds = atoi(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--max-function-ms") == 0 && atof(argv[argument_index + 1]) > 0) {
+            budget.maximum_milliseconds = atof(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--deadline-ms") == 0 && atof(argv[argument_index + 1]) > 0) {
+            deadline_ms = atof(argv[argument_index + 1]);
+            argument_index += 2;
+        } else if (strcmp(argv[argument_index], "--cache-size-mb") == 0 && atoll(argv[argument_index + 1]) > 0) {
+            cache_size_limit = (unsigned long long) atoll(argv[argument_index + 1]) << 20;
+            argument_index += 2;
+        } else {
+            fprintf(stderr, "Unknown option or missing value: %s\n", argv[argument_index]);
+            exit(1);
+        }
+    }
+
+    // edge case where the user did not provide adequate input
+    if (argument_index > argc - 1) {
+        fprintf(stderr, "%s", "You need to provide the path to the .ll file to optimize, or the paths of the .ll files to link");
+        exit(1);
+    }
+    LLVMContextRef context_for_parser = LLVMContextCreate();
+    LLVMModuleRef module = parse_input_file(argv[argument_index], context_for_parser);
+
+    // with several files the program is linked into the first one and optimized as a whole
+    bool is_linked = argument_index < argc - 1;
+    if (is_linked) {
+        std::vector<LLVMModuleRef> other_modules;
+        for (int input = argument_index + 1; input < argc; input++) {
+            other_modules.push_back(parse_input_file(argv[input], context_for_parser));
+        }
+        std::string link_error;
+        if (!link_modules(module, other_modules, link_error)) {
+            fprintf(stderr, "The modules could not be linked: %s\n", link_error.c_str());
+            exit(6);
+        }
+        // the evaluation calls its entry function from outside the program
+        if (evaluation.entry_function_name != NULL) {
+            exported_names.push_back(evaluation.entry_function_name);
+        }
+        bool is_an_export_defined = false;
+        for (const std::string &name : exported_names) {
+            LLVMValueRef exported = LLVMGetNamedFunction(module, name.c_str());
+            is_an_export_defined |= exported != NULL && LLVMCountBasicBlocks(exported) != 0;
+        }
+        if (is_an_export_defined) {
+            internalize_functions(module, exported_names);
+        } else { // internalizing would let every function be removed
+            fprintf(stderr, "%s\n", "None of the exported functions is defined in the linked modules, no function is made internal");
+        }
+        if (!has_inline_option) {
+            inline_threshold = INLINE_DEFAULT_THRESHOLD;
+        }
+        should_propagate_across_calls = true;
+    }
+
+    // the last of -O, --passes and --passes-file given wins
+    struct pass_pipeline pipeline;
+    std::string pipeline_error;
+    bool pipeline_is_valid = pipeline_file_path != NULL ? read_pass_pipeline_file(pipeline_file_path, pipeline, pipeline_error)
+                                                        : parse_pass_pipeline(pipeline_text, pipeline, pipeline_error);
+    if (!pipeline_is_valid) {
+        fprintf(stderr, "Invalid pass pipeline: %s (the passes are %s)\n", pipeline_error.c_str(), pass_pipeline_available_passes().c_str());
+        exit(1);
+    }
+
+    // functions whose body was already optimized in an earlier run are taken from the cache
+    struct function_cache *cache = NULL;
+    if (cache_path != NULL) {
+        cache = function_cache_open(cache_path, cache_size_limit, pipeline.description.c_str());
+        if (cache == NULL) {
+            fprintf(stderr, "The function cache %s is not valid, it is ignored\n", cache_path);
+        }
+    }
+
+    // the evaluation needs the module as it was before any pass ran
+    LLVMModuleRef original_module = should_evaluate ? LLVMCloneModule(module) : NULL;
+
+    if (print_hardware_counters) {
+        hardware_counters_start(); // without counters only the times are collected
+    }
+    struct optimizer_options options;
+    options.cache = cache;
+    options.pipeline = &pipeline;
+    options.budget = budget;
+    options.inline_threshold = inline_threshold;
+    options.interprocedural_constant_propagation = should_propagate_across_calls;
+    options.specialization_budget = specialization_budget;
+    options.dead_function_removal = is_linked;
+    options.attribute_inference = should_infer_attributes || is_linked;
+    if (number_of_threads == 0) {
+        number_of_threads = is_linked ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    }
+    options.number_of_threads = number_of_threads;
+    if (deadline_ms > 0) {
+        options.deadline_ns = optimizer_deadline_after_ms(deadline_ms);
+    }
+    struct optimizer_stats stats;
+    if (is_tiered) {
+        std::vector<struct optimizer_stats> function_stats;
+        for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+            function_stats.push_back(optimize_at_tier(func, OPTIMIZATION_TIER_0, options));
+        }
+        for (LLVMValueRef func = LLVMGetFirstFunction(module); func != NULL; func = LLVMGetNextFunction(func)) {
+            function_stats.push_back(promote_to_tier_1(func, options));
+        }
+        for (struct optimizer_stats &one_function : function_stats) {
+            stats.degraded_functions.insert(stats.degraded_functions.end(), one_function.degraded_functions.begin(), one_function.degraded_functions.end());
+            stats.functions_interrupted += one_function.functions_interrupted;
+            if (one_function.status != OPTIMIZER_COMPLETED) {
+                stats.status = one_function.status;
+            }
+        }
+    } else {
+        stats = optimize(module, options);
+    }
+    for (const std::string &degraded_function : stats.degraded_functions) {
+        fprintf(stderr, "Function %s ran out of compile budget and only got %s\n", degraded_function.c_str(), PIPELINE_DEGRADED);
+    }
+    if (stats.status == OPTIMIZER_DEADLINE_EXCEEDED) {
+        fprintf(stderr, "The deadline of %g ms passed: %u functions were stopped part way and %u were left as they were\n",
+                deadline_ms, stats.functions_interrupted, stats.functions_not_started);
+    }
+
+    if (cache != NULL) {
+        function_cache_print_statistics(cache, stderr);
+        function_cache_close(cache);
+    }
+
+    // after all the optimization has been performed we write the output to terminal
+    bool evaluation_matched = true;
+    if (should_evaluate) {
+        evaluation_matched = evaluate_optimization(original_module, LLVMCloneModule(module), evaluation, stdout);
+    } else {
+        LLVMDumpModule(module);
+    }
+
+    if (print_timing_report && timing_json_path == NULL) {
+        pass_timing_print_report(stderr);
+    }
+    if (hardware_counters_enabled) {
+        pass_timing_print_hardware_report(stderr);
+    }
+    if (is_tiered) {
+        print_tier_latency_report(stderr);
+    }
+#ifdef OPTIMIZER_ALLOCATION_PROFILING
+    print_allocation_report(stderr);
+#endif
+    if (print_statistics) {
+        print_optimizer_statistics(stderr);
+    }
+    if (statistics_json_path != NULL) {
+        FILE *statistics_json = fopen(statistics_json_path, "w");
+        if (statistics_json == NULL) {
+            fprintf(stderr, "Could not write the statistics to %s\n", statistics_json_path);
+        } else {
+            print_optimizer_statistics_json(statistics_json);
+            fclose(statistics_json);
+        }
+    }
+    if (timing_json_path != NULL) {
+        FILE *timing_json = fopen(timing_json_path, "w");
+        if (timing_json == NULL) {
+            fprintf(stderr, "Could not write the timing report to %s\n", timing_json_path);
+        } else {
+            pass_timing_print_json(timing_json);
+            fclose(timing_json);
+        }
+    }
+    // and then dispose
+    LLVMDisposeModule(module);
+    LLVMContextDispose(context_for_parser);
+    return evaluation_matched ? 0 : 7;
+}
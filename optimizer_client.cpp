@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include "optimizer_server.h"
+
+// Local client for the optimizer server, used for testing
+//
+// ./optimizer_client <socket_path> --stats
+// ./optimizer_client <socket_path> <input_file>...                      (optimized IR is written to terminal)
+// ./optimizer_client <socket_path> --bitcode <output_file> <input_file> (optimized bitcode is written to output_file)
+
+static bool read_whole_file(const char *path, std::string &contents) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    char chunk[65536];
+    size_t amount_read;
+    while ((amount_read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        contents.append(chunk, amount_read);
+    }
+    fclose(file);
+    return true;
+}
+
+// sends one request and waits for its response, returns false if the connection broke
+static bool send_request(int server_fd, char request_kind, const std::string &payload, unsigned char &status, std::string &response) {
+    uint64_t payload_size = payload.size();
+    if (!write_all_bytes(server_fd, &request_kind, 1) ||
+        !write_all_bytes(server_fd, &payload_size, sizeof(payload_size)) ||
+        !write_all_bytes(server_fd, payload.data(), payload_size)) {
+        return false;
+    }
+    uint64_t response_size;
+    if (!read_all_bytes(server_fd, &status, 1) || !read_all_bytes(server_fd, &response_size, sizeof(response_size))) {
+        return false;
+    }
+    response.resize(response_size);
+    return read_all_bytes(server_fd, &response[0], response_size);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "%s\n", "You need to provide the socket path and then --stats or the files to optimize");
+        exit(1);
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s\n", "The socket path is too long");
+        exit(2);
+    }
+    strcpy(address.sun_path, argv[1]);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0 || connect(server_fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        perror("connect");
+        exit(2);
+    }
+
+    unsigned char status;
+    std::string response;
+
+    if (strcmp(argv[2], "--stats") == 0) {
+        if (!send_request(server_fd, REQUEST_STATISTICS, "", status, response)) {
+            fprintf(stderr, "%s\n", "The server closed the connection");
+            exit(3);
+        }
+        fputs(response.c_str(), stdout);
+        close(server_fd);
+        return 0;
+    }
+
+    char request_kind = REQUEST_OPTIMIZE_TO_TEXT;
+    const char *bitcode_output_path = NULL;
+    int first_input = 2;
+    if (strcmp(argv[2], "--bitcode") == 0) {
+        if (argc != 5) {
+            fprintf(stderr, "%s\n", "--bitcode expects the output file and exactly one input file");
+            exit(1);
+        }
+        request_kind = REQUEST_OPTIMIZE_TO_BITCODE;
+        bitcode_output_path = argv[3];
+        first_input = 4;
+    }
+
+    // every input goes through the same connection so the server keeps it on one warm worker
+    for (int i = first_input; i < argc; i++) {
+        std::string payload;
+        if (!read_whole_file(argv[i], payload)) {
+            fprintf(stderr, "Could not read %s\n", argv[i]);
+            exit(4);
+        }
+        if (!send_request(server_fd, request_kind, payload, status, response)) {
+            fprintf(stderr, "%s\n", "The server closed the connection");
+            exit(3);
+        }
+        if (status != RESPONSE_OK) {
+            fprintf(stderr, "%s: %s\n", argv[i], response.c_str());
+            exit(5);
+        }
+
+        if (bitcode_output_path != NULL) {
+            FILE *output = fopen(bitcode_output_path, "wb");
+            if (output == NULL || fwrite(response.data(), 1, response.size(), output) != response.size()) {
+                fprintf(stderr, "Could not write %s\n", bitcode_output_path);
+                exit(4);
+            }
+            fclose(output);
+        } else {
+            fwrite(response.data(), 1, response.size(), stdout);
+        }
+    }
+    close(server_fd);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/PassPlugin.h>
+#include <llvm-c/Core.h>
+#include "optimizer.h"
+#include "local_and_global.h"
+#include "function_arena.h"
+
+// Pass plugin for opt and any tool built on LLVM's new pass manager
+//
+//   opt -load-pass-plugin=./OptimizerPasses.so -passes='function(optimizer-cse,optimizer-dce)' in.ll -S
+//
+// optimizer-cse, optimizer-constant-folding, optimizer-dce and optimizer-global-constant-propagation
+// are the passes of local_and_global.cpp, and optimizer-pipeline is the whole sequence of
+// optimize(). They only replace, fold and erase instructions and never touch blocks, edges or
+// terminators. A pass that changed nothing preserves every analysis, and one that changed the
+// function still preserves the CFG analyses. So the dominator trees, loop info and the other
+// results LLVM has cached stay valid for the passes that run after these.
+//
+// The plugin must be built with -fno-rtti like LLVM itself, see the README.
+
+namespace {
+
+llvm::PreservedAnalyses preserved_analyses_after(bool changed) {
+    if (!changed) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+
+struct optimizer_cse_pass : llvm::PassInfoMixin<optimizer_cse_pass> {
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &) {
+        bool changed = false;
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(llvm::wrap(&function)); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            changed |= run_common_subexpression_elimination(bb);
+        }
+        return preserved_analyses_after(changed);
+    }
+};
+
+struct optimizer_constant_folding_pass : llvm::PassInfoMixin<optimizer_constant_folding_pass> {
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &) {
+        bool changed = false;
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(llvm::wrap(&function)); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            changed |= run_constant_folding(bb);
+        }
+        return preserved_analyses_after(changed);
+    }
+};
+
+struct optimizer_dce_pass : llvm::PassInfoMixin<optimizer_dce_pass> {
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &) {
+        return preserved_analyses_after(run_dead_code_elimination(llvm::wrap(&function)));
+    }
+};
+
+struct optimizer_global_constant_propagation_pass : llvm::PassInfoMixin<optimizer_global_constant_propagation_pass> {
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &) {
+        if (function.isDeclaration()) {
+            return llvm::PreservedAnalyses::all();
+        }
+        function_arena_scope arena_scope; // optimize() opens it for the other passes
+        return preserved_analyses_after(constant_propagation_and_constant_folding(llvm::wrap(&function)));
+    }
+};
+
+struct optimizer_pipeline_pass : llvm::PassInfoMixin<optimizer_pipeline_pass> {
+    llvm::PreservedAnalyses run(llvm::Function &function, llvm::FunctionAnalysisManager &) {
+        struct optimizer_stats stats = optimize(llvm::wrap(&function));
+        // every change the passes make erases at least one instruction
+        return preserved_analyses_after(stats.instructions_after != stats.instructions_before);
+    }
+};
+
+bool add_optimizer_pass(llvm::StringRef name, llvm::FunctionPassManager &passes) {
+    if (name == "optimizer-cse") {
+        passes.addPass(optimizer_cse_pass());
+    } else if (name == "optimizer-constant-folding") {
+        passes.addPass(optimizer_constant_folding_pass());
+    } else if (name == "optimizer-dce") {
+        passes.addPass(optimizer_dce_pass());
+    } else if (name == "optimizer-global-constant-propagation") {
+        passes.addPass(optimizer_global_constant_propagation_pass());
+    } else if (name == "optimizer-pipeline") {
+        passes.addPass(optimizer_pipeline_pass());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return {LLVM_PLUGIN_API_VERSION, "OptimizerPasses", OPTIMIZER_VERSION, [](llvm::PassBuilder &builder) {
+                builder.registerPipelineParsingCallback(
+                    [](llvm::StringRef name, llvm::FunctionPassManager &passes, llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
+                        return add_optimizer_pass(name, passes);
+                    });
+            }};
+}
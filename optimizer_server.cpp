@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/BitWriter.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "optimizer.h"
+#include "optimizer_server.h"
+#include "latency_statistics.h"
+
+// how long blocking calls wait before checking again if the server was asked to stop
+#define SHUTDOWN_POLL_INTERVAL_MS 200
+// a warm context keeps every constant and type it has ever seen, so it is recreated
+// after this many requests to keep the memory of a long running server bounded
+#define REQUESTS_BEFORE_CONTEXT_RECYCLE 1000
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int signal_number) {
+    (void) signal_number;
+    stop_requested = 1;
+}
+
+struct latency_statistics {
+    std::mutex lock;
+    unsigned long long failed_requests = 0;
+    struct latency_samples samples;
+};
+
+// A worker answers one request and hands the connection back, so a client that keeps its
+// connection open between requests holds no worker. The accepting thread polls the idle
+// connections with the listening socket and queues one for the workers when its next request
+// arrives. pending_fds is bounded so that a burst of requests waits in the sockets instead of
+// piling up in memory, and so is the number of open connections.
+struct connection_queue {
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::deque<int> pending_fds; // a request is waiting on each of them
+    std::vector<int> idle_fds;   // waiting for their next request
+    size_t capacity = 0;
+    unsigned open_connections = 0; // pending, idle and being answered
+    unsigned maximum_open_connections = 0;
+    bool closed = false;
+    int wake_fds[2] = {-1, -1}; // a byte written to wake_fds[1] wakes the accepting thread's poll
+};
+
+struct server_state {
+    connection_queue queue;
+    latency_statistics statistics;
+};
+
+static void record_latency(latency_statistics &statistics, double elapsed_ms, bool failed) {
+    std::lock_guard<std::mutex> guard(statistics.lock);
+    record_latency_sample(statistics.samples, elapsed_ms);
+    if (failed) {
+        statistics.failed_requests++;
+    }
+}
+
+static std::string format_latency_statistics(latency_statistics &statistics) {
+    std::lock_guard<std::mutex> guard(statistics.lock);
+    struct latency_summary summary = summarize_latency_samples(statistics.samples);
+    char text[512];
+    snprintf(text, sizeof(text),
+             "requests: %llu\nfailed: %llu\nmean_ms: %.3f\nmin_ms: %.3f\np50_ms: %.3f\np99_ms: %.3f\nmax_ms: %.3f\n",
+             statistics.samples.count, statistics.failed_requests, summary.mean_ms, summary.min_ms, summary.p50_ms,
+             summary.p99_ms, summary.max_ms);
+    return std::string(text);
+}
+
+// parses the payload (textual IR or bitcode), runs the same pass sequence as main() and
+// serializes the result in the requested format
+static bool optimize_payload(LLVMContextRef context, const std::vector<char> &payload, char request_kind,
+                             std::string &output, std::string &error) {
+    // the parser takes ownership of the buffer, so it is not disposed here
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(payload.data(), payload.size(), "request");
+    LLVMModuleRef module = NULL;
+    char *err_message = NULL;
+    if (LLVMParseIRInContext(context, buffer, &module, &err_message)) {
+        error = err_message != NULL ? err_message : "could not parse the IR";
+        if (err_message != NULL) LLVMDisposeMessage(err_message);
+        if (module) LLVMDisposeModule(module);
+        return false;
+    }
+
+    optimize(module);
+
+    if (request_kind == REQUEST_OPTIMIZE_TO_BITCODE) {
+        LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+        output.assign(LLVMGetBufferStart(bitcode), LLVMGetBufferSize(bitcode));
+        LLVMDisposeMemoryBuffer(bitcode);
+    } else {
+        char *text = LLVMPrintModuleToString(module);
+        output.assign(text);
+        LLVMDisposeMessage(text);
+    }
+    LLVMDisposeModule(module);
+    return true;
+}
+
+// the accepting thread polls again, with the connections the workers gave back or freed room
+static void wake_accepting_thread(connection_queue &queue) {
+    char byte = 0;
+    ssize_t amount_written = write(queue.wake_fds[1], &byte, 1);
+    (void) amount_written; // when the pipe is full a wake up is already pending
+}
+
+static bool send_response(int client_fd, unsigned char status, const std::string &payload) {
+    uint64_t payload_size = payload.size();
+    return write_all_bytes(client_fd, &status, 1) &&
+           write_all_bytes(client_fd, &payload_size, sizeof(payload_size)) &&
+           write_all_bytes(client_fd, payload.data(), payload_size);
+}
+
+// answers the request waiting on a connection, the warm context is reused between requests.
+// Returns false when the connection has to be closed.
+static bool serve_request(server_state &state, LLVMContextRef &warm_context, unsigned &requests_on_context, int client_fd) {
+    char request_kind;
+    uint64_t payload_size;
+    if (!read_all_bytes(client_fd, &request_kind, 1) || !read_all_bytes(client_fd, &payload_size, sizeof(payload_size))) {
+        return false; // the client closed the connection
+    }
+
+    if (request_kind == REQUEST_STATISTICS) {
+        if (payload_size != 0) { // its bytes would be read as the next request
+            send_response(client_fd, RESPONSE_ERROR, "a statistics request has no payload");
+            return false;
+        }
+        return send_response(client_fd, RESPONSE_OK, format_latency_statistics(state.statistics));
+    }
+    if (request_kind != REQUEST_OPTIMIZE_TO_TEXT && request_kind != REQUEST_OPTIMIZE_TO_BITCODE) {
+        send_response(client_fd, RESPONSE_ERROR, "unknown request kind");
+        return false; // the rest of the stream cannot be trusted anymore
+    }
+    if (payload_size > MAXIMUM_PAYLOAD_SIZE) {
+        send_response(client_fd, RESPONSE_ERROR, "payload is too large");
+        return false;
+    }
+
+    std::vector<char> payload(payload_size);
+    if (!read_all_bytes(client_fd, payload.data(), payload_size)) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string output;
+    std::string error;
+    bool succeeded = optimize_payload(warm_context, payload, request_kind, output, error);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    record_latency(state.statistics, elapsed_ms, !succeeded);
+
+    if (++requests_on_context >= REQUESTS_BEFORE_CONTEXT_RECYCLE) {
+        LLVMContextDispose(warm_context);
+        warm_context = LLVMContextCreate();
+        requests_on_context = 0;
+    }
+
+    return succeeded ? send_response(client_fd, RESPONSE_OK, output) : send_response(client_fd, RESPONSE_ERROR, error);
+}
+
+// each worker owns its context since an LLVMContextRef must not be shared between threads
+static void worker_loop(server_state *state) {
+    LLVMContextRef warm_context = LLVMContextCreate();
+    unsigned requests_on_context = 0;
+    while (true) {
+        int client_fd;
+        {
+            std::unique_lock<std::mutex> guard(state->queue.lock);
+            state->queue.not_empty.wait(guard, [state] { return state->queue.closed || !state->queue.pending_fds.empty(); });
+            if (state->queue.pending_fds.empty()) { // closed and drained
+                break;
+            }
+            client_fd = state->queue.pending_fds.front();
+            state->queue.pending_fds.pop_front();
+        }
+        bool keeps_connection = serve_request(*state, warm_context, requests_on_context, client_fd);
+        {
+            std::lock_guard<std::mutex> guard(state->queue.lock);
+            if (keeps_connection && !state->queue.closed) {
+                state->queue.idle_fds.push_back(client_fd);
+            } else {
+                close(client_fd);
+                state->queue.open_connections--;
+            }
+        }
+        wake_accepting_thread(state->queue); // the pending queue has room again in any case
+    }
+    LLVMContextDispose(warm_context);
+}
+
+int run_optimizer_server(const char *socket_path, int number_of_workers) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s\n", "The socket path is too long");
+        return 6;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 6;
+    }
+    unlink(socket_path); // a stale socket left by a previous server would make bind fail
+    if (bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        perror("bind");
+        close(listen_fd);
+        return 6;
+    }
+
+    struct sigaction stop_action;
+    memset(&stop_action, 0, sizeof(stop_action));
+    stop_action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+    signal(SIGPIPE, SIG_IGN); // a client leaving mid response must not kill the server
+
+    server_state state;
+    state.queue.capacity = (size_t) number_of_workers * PENDING_CONNECTIONS_PER_WORKER;
+    state.queue.maximum_open_connections = (unsigned) number_of_workers * OPEN_CONNECTIONS_PER_WORKER;
+    if (pipe(state.queue.wake_fds) != 0) {
+        perror("pipe");
+        close(listen_fd);
+        return 6;
+    }
+    fcntl(state.queue.wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(state.queue.wake_fds[1], F_SETFL, O_NONBLOCK);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < number_of_workers; i++) {
+        workers.emplace_back(worker_loop, &state);
+    }
+    fprintf(stderr, "Optimizer server listening on %s with %d workers\n", socket_path, number_of_workers);
+
+    // polls[0] is the wake pipe, then the listening socket when a new client can be taken, then the
+    // idle connections when a request can be queued. When every worker is busy and the queue is
+    // full nothing is read or accepted, which applies backpressure.
+    std::vector<struct pollfd> polls;
+    while (!stop_requested) {
+        polls.assign(1, {state.queue.wake_fds[0], POLLIN, 0});
+        bool polls_listen_fd;
+        {
+            std::lock_guard<std::mutex> guard(state.queue.lock);
+            bool has_room = state.queue.pending_fds.size() < state.queue.capacity;
+            polls_listen_fd = has_room && state.queue.open_connections < state.queue.maximum_open_connections;
+            if (polls_listen_fd) {
+                polls.push_back({listen_fd, POLLIN, 0});
+            }
+            for (size_t i = 0; has_room && i < state.queue.idle_fds.size(); i++) {
+                polls.push_back({state.queue.idle_fds[i], POLLIN, 0});
+            }
+        }
+        if (poll(polls.data(), polls.size(), SHUTDOWN_POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+        if (polls[0].revents != 0) {
+            char drained[64];
+            while (read(state.queue.wake_fds[0], drained, sizeof(drained)) > 0) {
+                continue; // the wake ups only ask for another poll
+            }
+        }
+        size_t first_idle = polls_listen_fd ? 2 : 1;
+        int client_fd = polls_listen_fd && polls[1].revents != 0 ? accept(listen_fd, NULL, NULL) : -1;
+        bool queued_a_request = false;
+        {
+            std::lock_guard<std::mutex> guard(state.queue.lock);
+            // a request or a hang up, the worker tells them apart when it reads
+            for (size_t i = first_idle; i < polls.size(); i++) {
+                if (polls[i].revents != 0) {
+                    state.queue.idle_fds.erase(std::find(state.queue.idle_fds.begin(), state.queue.idle_fds.end(), polls[i].fd));
+                    state.queue.pending_fds.push_back(polls[i].fd);
+                    queued_a_request = true;
+                }
+            }
+            // a new client may not have sent anything yet, it waits with the idle connections
+            if (client_fd >= 0) {
+                state.queue.idle_fds.push_back(client_fd);
+                state.queue.open_connections++;
+            }
+        }
+        if (queued_a_request) {
+            state.queue.not_empty.notify_all();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(state.queue.lock);
+        state.queue.closed = true;
+    }
+    state.queue.not_empty.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (int client_fd : state.queue.idle_fds) {
+        close(client_fd);
+    }
+    close(state.queue.wake_fds[0]);
+    close(state.queue.wake_fds[1]);
+    close(listen_fd);
+    unlink(socket_path);
+
+    fprintf(stderr, "%s", format_latency_statistics(state.statistics).c_str());
+    return 0;
+}
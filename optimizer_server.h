@@ -0,0 +1,69 @@
+#ifndef OPTIMIZER_SERVER_H
+#define OPTIMIZER_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Protocol spoken over the Unix domain socket (shared by the server and optimizer_client)
+//
+// request:  1 byte kind, 8 bytes payload length (host byte order), payload
+// response: 1 byte status, 8 bytes payload length (host byte order), payload
+//
+// A client may send several requests over the same connection, they are answered in order.
+
+// request kinds
+#define REQUEST_OPTIMIZE_TO_TEXT 'T'    // payload is textual IR or bitcode, answer is textual IR
+#define REQUEST_OPTIMIZE_TO_BITCODE 'B' // payload is textual IR or bitcode, answer is bitcode
+#define REQUEST_STATISTICS 'S'          // no payload, answer is the latency statistics as text
+
+// response status
+#define RESPONSE_OK 0
+#define RESPONSE_ERROR 1 // payload is the error message
+
+#define DEFAULT_NUMBER_OF_WORKERS 4
+// requests allowed to wait per worker before the server stops reading and accepting
+#define PENDING_CONNECTIONS_PER_WORKER 4
+// open connections allowed per worker, idle ones included, before accept() stops taking new clients
+#define OPEN_CONNECTIONS_PER_WORKER 64
+// upper bound on the size of an accepted payload so a bad client cannot exhaust memory
+#define MAXIMUM_PAYLOAD_SIZE (1ull << 30)
+
+// Runs until SIGINT or SIGTERM is received, returns the exit code for main()
+int run_optimizer_server(const char *socket_path, int number_of_workers);
+
+// helpers to move whole buffers through a socket, they return false if the peer went away
+static inline bool read_all_bytes(int fd, void *data, uint64_t size) {
+    char *cursor = (char *) data;
+    while (size > 0) {
+        ssize_t amount_read = read(fd, cursor, size);
+        if (amount_read < 0 && errno == EINTR) { // interrupted by a signal before anything moved
+            continue;
+        }
+        if (amount_read <= 0) {
+            return false;
+        }
+        cursor += amount_read;
+        size -= amount_read;
+    }
+    return true;
+}
+
+static inline bool write_all_bytes(int fd, const void *data, uint64_t size) {
+    const char *cursor = (const char *) data;
+    while (size > 0) {
+        ssize_t amount_written = write(fd, cursor, size);
+        if (amount_written < 0 && errno == EINTR) { // interrupted by a signal before anything moved
+            continue;
+        }
+        if (amount_written <= 0) {
+            return false;
+        }
+        cursor += amount_written;
+        size -= amount_written;
+    }
+    return true;
+}
+
+#endif
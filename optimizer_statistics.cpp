@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "optimizer_statistics.h"
+
+// head of the list every counter adds itself to during static initialization
+static optimizer_statistic *first_registered_statistic = NULL;
+
+optimizer_statistic::optimizer_statistic(const char *pass, const char *name, const char *what)
+    : pass_name(pass), counter_name(name), description(what), value(0), next_registered(first_registered_statistic) {
+    first_registered_statistic = this;
+}
+
+// sorted by pass and then by counter so the output is stable between runs and releases
+static std::vector<optimizer_statistic *> sorted_nonzero_statistics() {
+    std::vector<optimizer_statistic *> statistics;
+    for (optimizer_statistic *statistic = first_registered_statistic; statistic != NULL; statistic = statistic->next_registered) {
+        if (statistic->value.load(std::memory_order_relaxed) != 0) {
+            statistics.push_back(statistic);
+        }
+    }
+    std::sort(statistics.begin(), statistics.end(), [](optimizer_statistic *a, optimizer_statistic *b) {
+        int pass_order = strcmp(a->pass_name, b->pass_name);
+        return pass_order != 0 ? pass_order < 0 : strcmp(a->counter_name, b->counter_name) < 0;
+    });
+    return statistics;
+}
+
+void print_optimizer_statistics(FILE *output) {
+    fprintf(output, "===== Optimizer statistics =====\n");
+    for (optimizer_statistic *statistic : sorted_nonzero_statistics()) {
+        fprintf(output, "%12llu %-28s - %s\n", statistic->value.load(std::memory_order_relaxed), statistic->pass_name, statistic->description);
+    }
+}
+
+void print_optimizer_statistics_json(FILE *output) {
+    std::vector<optimizer_statistic *> statistics = sorted_nonzero_statistics();
+    fprintf(output, "{");
+    for (size_t i = 0; i < statistics.size(); i++) {
+        // names are C identifiers so they never need escaping
+        fprintf(output, "%s\n  \"%s.%s\": %llu", i == 0 ? "" : ",", statistics[i]->pass_name, statistics[i]->counter_name,
+                statistics[i]->value.load(std::memory_order_relaxed));
+    }
+    fprintf(output, "\n}\n");
+}
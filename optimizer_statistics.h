@@ -0,0 +1,37 @@
+#ifndef OPTIMIZER_STATISTICS_H
+#define OPTIMIZER_STATISTICS_H
+
+#include <stdio.h>
+#include <atomic>
+
+// Named counters incremented by the passes, in the spirit of LLVM's STATISTIC
+//
+// A counter is declared once at file scope with OPTIMIZER_STATISTIC and registers itself before
+// main() runs. Updates are relaxed atomics so several threads may optimize at the same time.
+
+struct optimizer_statistic {
+    const char *pass_name;
+    const char *counter_name;
+    const char *description;
+    std::atomic<unsigned long long> value;
+    optimizer_statistic *next_registered;
+
+    optimizer_statistic(const char *pass, const char *name, const char *what);
+
+    void operator++(int) { value.fetch_add(1, std::memory_order_relaxed); }
+    void operator+=(unsigned long long amount) { value.fetch_add(amount, std::memory_order_relaxed); }
+    // for counters that track the worst case seen, e.g. the most rounds a fixed point needed
+    void record_maximum(unsigned long long candidate) {
+        unsigned long long current = value.load(std::memory_order_relaxed);
+        while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+#define OPTIMIZER_STATISTIC(variable, pass, description) static optimizer_statistic variable(pass, #variable, description)
+
+// counters that are still zero are left out of both outputs
+void print_optimizer_statistics(FILE *output);
+void print_optimizer_statistics_json(FILE *output);
+
+#endif
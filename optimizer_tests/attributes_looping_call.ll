@@ -0,0 +1,20 @@
+; ./optimizer_executable --infer-attributes optimizer_tests/attributes_looping_call.ll
+; @spin reads no memory but may never return, so its unused call has to stay
+define internal i32 @spin(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %next
+}
+
+define i32 @func(i32 %a) {
+  %1 = call i32 @spin(i32 %a)
+  ret i32 %a
+}
@@ -0,0 +1,25 @@
+; ModuleID = 'optimizer_tests/attributes_looping_call.ll'
+source_filename = "optimizer_tests/attributes_looping_call.ll"
+
+; Function Attrs: nounwind readnone
+define internal i32 @spin(i32 %n) #0 {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:                                             ; preds = %loop
+  ret i32 %next
+}
+
+; Function Attrs: nounwind readnone
+define i32 @func(i32 %a) #0 {
+  %1 = call i32 @spin(i32 %a)
+  ret i32 %a
+}
+
+attributes #0 = { nounwind readnone }
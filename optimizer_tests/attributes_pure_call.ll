@@ -0,0 +1,13 @@
+; ./optimizer_executable --infer-attributes optimizer_tests/attributes_pure_call.ll
+; @square reads no memory, so the second call gives the first one's result and is erased
+define internal i32 @square(i32 %x) {
+  %m = mul i32 %x, %x
+  ret i32 %m
+}
+
+define i32 @func(i32 %a) {
+  %1 = call i32 @square(i32 %a)
+  %2 = call i32 @square(i32 %a)
+  %3 = add i32 %1, %2
+  ret i32 %3
+}
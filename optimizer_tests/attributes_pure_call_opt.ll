@@ -0,0 +1,17 @@
+; ModuleID = 'optimizer_tests/attributes_pure_call.ll'
+source_filename = "optimizer_tests/attributes_pure_call.ll"
+
+; Function Attrs: nounwind readnone willreturn
+define internal i32 @square(i32 %x) #0 {
+  %m = mul i32 %x, %x
+  ret i32 %m
+}
+
+; Function Attrs: nounwind readnone willreturn
+define i32 @func(i32 %a) #0 {
+  %1 = call i32 @square(i32 %a)
+  %2 = add i32 %1, %1
+  ret i32 %2
+}
+
+attributes #0 = { nounwind readnone willreturn }
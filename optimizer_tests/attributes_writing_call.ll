@@ -0,0 +1,17 @@
+; ./optimizer_executable --infer-attributes optimizer_tests/attributes_writing_call.ll
+; @reset writes @g, so neither the stored 5 nor the first load of @g reaches the loads after it
+@g = global i32 0
+
+define internal void @reset() {
+  store i32 0, ptr @g, align 4
+  ret void
+}
+
+define i32 @func(i32 %a) {
+  store i32 5, ptr @g, align 4
+  %1 = load i32, ptr @g, align 4
+  call void @reset()
+  %2 = load i32, ptr @g, align 4
+  %3 = add i32 %1, %2
+  ret i32 %3
+}
@@ -0,0 +1,22 @@
+; ModuleID = 'optimizer_tests/attributes_writing_call.ll'
+source_filename = "optimizer_tests/attributes_writing_call.ll"
+
+@g = global i32 0
+
+; Function Attrs: nounwind willreturn
+define internal void @reset() #0 {
+  store i32 0, ptr @g, align 4
+  ret void
+}
+
+; Function Attrs: nounwind willreturn
+define i32 @func(i32 %a) #0 {
+  store i32 5, ptr @g, align 4
+  %1 = load i32, ptr @g, align 4
+  call void @reset()
+  %2 = load i32, ptr @g, align 4
+  %3 = add i32 %1, %2
+  ret i32 %3
+}
+
+attributes #0 = { nounwind willreturn }
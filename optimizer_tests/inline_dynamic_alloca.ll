@@ -0,0 +1,18 @@
+; ./optimizer_executable --inline optimizer_tests/inline_dynamic_alloca.ll
+; the alloca of @sum is sized by its parameter, it cannot move to the entry of main ahead of %m
+define internal i32 @sum(i32 %n) {
+  %buf = alloca i32, i32 %n, align 4
+  store i32 %n, ptr %buf, align 4
+  %v = load i32, ptr %buf, align 4
+  ret i32 %v
+}
+
+define i32 @main(i32 %a) {
+entry:
+  br label %next
+
+next:
+  %m = add i32 %a, 1
+  %r = call i32 @sum(i32 %m)
+  ret i32 %r
+}
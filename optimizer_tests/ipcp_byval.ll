@@ -0,0 +1,16 @@
+; ./optimizer_executable --ipcp optimizer_tests/ipcp_byval.ll
+; @f gets its own copy of @g, so storing through %p must leave @g alone and main returns 1
+%struct.S = type { i32, i32 }
+
+@g = global %struct.S { i32 1, i32 2 }
+
+define internal void @f(ptr byval(%struct.S) %p) {
+  store i32 100, ptr %p, align 4
+  ret void
+}
+
+define i32 @main() {
+  call void @f(ptr byval(%struct.S) @g)
+  %a = load i32, ptr @g, align 4
+  ret i32 %a
+}
@@ -0,0 +1,17 @@
+; ModuleID = 'optimizer_tests/specialize_byval.ll'
+source_filename = "optimizer_tests/specialize_byval.ll"
+
+%struct.S = type { i32, i32 }
+
+@g = global %struct.S { i32 1, i32 2 }
+
+define void @f(ptr byval(%struct.S) %p) {
+  store i32 100, ptr %p, align 4
+  ret void
+}
+
+define i32 @main() {
+  call void @f(ptr byval(%struct.S) @g)
+  %a = load i32, ptr @g, align 4
+  ret i32 %a
+}
@@ -0,0 +1,24 @@
+; ./optimizer_executable --specialize optimizer_tests/specialize_internal.ll
+; without --ipcp nothing else gets the 10 both calls pass into @sum, so it is specialized and main returns 90
+define internal i32 @sum(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @main() {
+  %a = call i32 @sum(i32 10)
+  %b = call i32 @sum(i32 10)
+  %c = add i32 %a, %b
+  ret i32 %c
+}
@@ -0,0 +1,41 @@
+; ModuleID = 'optimizer_tests/specialize_internal.ll'
+source_filename = "optimizer_tests/specialize_internal.ll"
+
+define internal i32 @sum(i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
+
+define i32 @main() {
+  %a = call i32 @sum.specialized.1(i32 10)
+  %b = call i32 @sum.specialized.1(i32 10)
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+define internal i32 @sum.specialized.1(i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %s.next = add i32 %s, %i
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, 10
+  br i1 %done, label %exit, label %loop
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "pass_pipeline.h"
+#include "local_and_global.h"
+#include "function_analysis_manager.h"
+#include "pass_timing.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(group_rounds, "pipeline", "Number of rounds run by fixed-point groups");
+OPTIMIZER_STATISTIC(pass_runs_skipped, "pipeline", "Number of pass runs a fixed-point group skipped because nothing they depend on changed");
+
+static bool run_dead_code_elimination_pass(LLVMValueRef func, struct function_analysis_manager &) {
+    return run_dead_code_elimination(func);
+}
+
+// cse finds new duplicates when operands were replaced, folding only when they became constants,
+// constant propagation when stored values became constants and dce after any change. Reaching
+// definitions kept across cse can be a superset, see function_analysis_manager.h
+static const struct pipeline_pass available_passes[] = {
+    {"cse", run_common_subexpression_elimination, NULL, PASS_CHANGE_REPLACEMENTS,
+     PASS_CHANGE_CONSTANTS | PASS_CHANGE_REPLACEMENTS, false, ANALYSIS_REACHING_DEFINITIONS},
+    {"constant-folding", run_constant_folding, NULL, PASS_CHANGE_CONSTANTS | PASS_CHANGE_ERASURES, PASS_CHANGE_CONSTANTS, false,
+     ANALYSIS_REACHING_DEFINITIONS},
+    {"dce", NULL, run_dead_code_elimination_pass, PASS_CHANGE_ERASURES, PASS_CHANGE_ANY, true, ANALYSIS_REACHING_DEFINITIONS},
+    {"constant-propagation", NULL, taking_load_into_consideration, PASS_CHANGE_CONSTANTS | PASS_CHANGE_ERASURES,
+     PASS_CHANGE_CONSTANTS, false, ANALYSIS_REACHING_DEFINITIONS},
+    // constant propagation and folding to their fixed point and then dce, as one pass
+    {"global-constant-propagation", NULL, constant_propagation_and_constant_folding, PASS_CHANGE_CONSTANTS | PASS_CHANGE_ERASURES,
+     PASS_CHANGE_CONSTANTS, true, ANALYSIS_REACHING_DEFINITIONS},
+};
+#define NUMBER_OF_AVAILABLE_PASSES (sizeof(available_passes) / sizeof(available_passes[0]))
+
+#define FIXED_POINT_GROUP_NAME "fixed-point"
+
+const char *pass_pipeline_preset(const char *level) {
+    if (strcmp(level, "0") == 0) return PIPELINE_O0;
+    if (strcmp(level, "1") == 0) return PIPELINE_O1;
+    if (strcmp(level, "2") == 0) return PIPELINE_O2;
+    return NULL;
+}
+
+std::string pass_pipeline_available_passes() {
+    std::string names;
+    for (size_t p = 0; p < NUMBER_OF_AVAILABLE_PASSES; p++) {
+        names += (p == 0 ? "" : ",") + std::string(available_passes[p].name);
+    }
+    return names;
+}
+
+static const struct pipeline_pass *find_pass(const std::string &name) {
+    for (size_t p = 0; p < NUMBER_OF_AVAILABLE_PASSES; p++) {
+        if (name == available_passes[p].name) {
+            return &available_passes[p];
+        }
+    }
+    return NULL;
+}
+
+// the text without whitespace, so the parser only sees names, commas and parentheses
+static std::string without_whitespace(const char *text) {
+    std::string compact;
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c != ' ' && *c != '\t' && *c != '\n' && *c != '\r') {
+            compact += *c;
+        }
+    }
+    return compact;
+}
+
+static std::string read_name(const std::string &text, size_t &position) {
+    size_t start = position;
+    while (position < text.size() && text[position] != ',' && text[position] != '(' && text[position] != ')') {
+        position++;
+    }
+    return text.substr(start, position - start);
+}
+
+bool parse_pass_pipeline(const char *text, struct pass_pipeline &pipeline, std::string &error_message) {
+    std::string compact = without_whitespace(text);
+    pipeline.steps.clear();
+    pipeline.description.clear();
+    size_t position = 0;
+    while (position < compact.size()) {
+        std::string name = read_name(compact, position);
+        struct pipeline_step step;
+        step.is_fixed_point_group = name == FIXED_POINT_GROUP_NAME;
+        if (step.is_fixed_point_group) {
+            if (position >= compact.size() || compact[position] != '(') {
+                error_message = FIXED_POINT_GROUP_NAME " should be followed by the passes of the group in parentheses";
+                return false;
+            }
+            position++;
+            while (true) {
+                std::string member_name = read_name(compact, position);
+                const struct pipeline_pass *member = find_pass(member_name);
+                if (member_name == FIXED_POINT_GROUP_NAME) {
+                    error_message = "fixed-point groups do not nest";
+                    return false;
+                }
+                if (member == NULL) {
+                    error_message = member_name.empty() ? "a fixed-point group has an empty entry" : "unknown pass in a fixed-point group: " + member_name;
+                    return false;
+                }
+                step.passes.push_back(member);
+                if (position < compact.size() && compact[position] == ',') {
+                    position++;
+                } else if (position < compact.size() && compact[position] == ')') {
+                    position++;
+                    break;
+                } else {
+                    error_message = "a fixed-point group is not closed";
+                    return false;
+                }
+            }
+        } else {
+            const struct pipeline_pass *pass = find_pass(name);
+            if (pass == NULL) {
+                error_message = name.empty() ? "the pipeline has an empty entry" : "unknown pass: " + name;
+                return false;
+            }
+            step.passes.push_back(pass);
+        }
+        pipeline.steps.push_back(step);
+
+        if (position < compact.size()) {
+            if (compact[position] != ',' || position + 1 == compact.size()) {
+                error_message = "passes should be separated by single commas";
+                return false;
+            }
+            position++;
+        }
+    }
+
+    for (size_t s = 0; s < pipeline.steps.size(); s++) {
+        const struct pipeline_step &step = pipeline.steps[s];
+        pipeline.description += s == 0 ? "" : ",";
+        pipeline.description += step.is_fixed_point_group ? FIXED_POINT_GROUP_NAME "(" : "";
+        for (size_t p = 0; p < step.passes.size(); p++) {
+            pipeline.description += (p == 0 ? "" : ",") + std::string(step.passes[p]->name);
+        }
+        pipeline.description += step.is_fixed_point_group ? ")" : "";
+    }
+    return true;
+}
+
+struct pass_pipeline built_in_pass_pipeline(const char *text) {
+    struct pass_pipeline parsed;
+    std::string error_message;
+    parse_pass_pipeline(text, parsed, error_message);
+    return parsed;
+}
+
+// a pipeline file holds the same text as --passes, over any number of lines
+bool read_pass_pipeline_file(const char *path, struct pass_pipeline &pipeline, std::string &error_message) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        error_message = std::string("could not open ") + path;
+        return false;
+    }
+    std::string text;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        text += line;
+    }
+    fclose(file);
+    return parse_pass_pipeline(text.c_str(), pipeline, error_message);
+}
+
+// runs passes in order, once or in rounds until a round changes nothing. pending[i] collects the
+// changes reported since passes[i] last ran and a later round only runs the passes that depend
+// on one of them. Block passes next to each other share one walk over the blocks.
+static void run_passes_in_order(const std::vector<const struct pipeline_pass *> &passes, LLVMValueRef func,
+                                struct function_analysis_manager &analyses, bool until_fixed_point) {
+    size_t number_of_passes = passes.size();
+    std::vector<unsigned> pending(number_of_passes, PASS_CHANGE_ANY); // the first round runs every pass
+    std::vector<bool> is_due(number_of_passes);
+    std::vector<bool> changed(number_of_passes);
+    bool is_first_round = true;
+    unsigned long long rounds_done = 0;
+    while (true) {
+        bool any_pass_ran = false;
+        size_t first = 0;
+        while (first < number_of_passes) {
+            if (analyses.budget.is_exhausted()) { // the function is valid between passes
+                return;
+            }
+            // the passes handled together: a function pass alone, or a run of block passes
+            size_t end = first + 1;
+            if (passes[first]->run_on_block != NULL) {
+                while (end < number_of_passes && passes[end]->run_on_block != NULL) end++;
+            }
+            bool any_due = false;
+            for (size_t i = first; i < end; i++) {
+                is_due[i] = is_first_round || (pending[i] & passes[i]->depends_on) != 0;
+                changed[i] = false;
+                if (is_due[i]) {
+                    pending[i] = 0;
+                    any_due = true;
+                } else {
+                    pass_runs_skipped++;
+                }
+            }
+            if (any_due) {
+                any_pass_ran = true;
+                if (passes[first]->run_on_function != NULL) {
+                    changed[first] = passes[first]->run_on_function(func, analyses);
+                } else {
+                    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+                        if (analyses.budget.is_exhausted()) break; // and between blocks, for a cancellation
+                        for (size_t i = first; i < end; i++) {
+                            if (is_due[i] && passes[i]->run_on_block(bb)) changed[i] = true;
+                        }
+                    }
+                }
+            }
+            for (size_t i = first; i < end; i++) {
+                if (!changed[i]) continue;
+                analyses.invalidate(passes[i]->preserved_analyses);
+                for (size_t other = 0; other < number_of_passes; other++) {
+                    if (other != i || !passes[i]->reaches_own_fixed_point) {
+                        pending[other] |= passes[i]->changes_made;
+                    }
+                }
+            }
+            first = end;
+        }
+        if (!until_fixed_point || !any_pass_ran) {
+            return;
+        }
+        group_rounds++;
+        rounds_done++;
+        is_first_round = false;
+        if (!analyses.budget.allows_round(rounds_done + 1, analyses.budget.limits.maximum_fixed_point_rounds, "fixed-point rounds")) {
+            return;
+        }
+    }
+}
+
+void run_pass_pipeline(const struct pass_pipeline &pipeline, struct function_analysis_manager &analyses) {
+    LLVMValueRef func = analyses.func;
+    // passes outside groups run once, in order
+    std::vector<const struct pipeline_pass *> sequence;
+    for (const struct pipeline_step &step : pipeline.steps) {
+        if (!step.is_fixed_point_group) {
+            sequence.push_back(step.passes[0]);
+            continue;
+        }
+        if (!sequence.empty()) {
+            run_passes_in_order(sequence, func, analyses, false);
+            sequence.clear();
+        }
+        scoped_pass_timer timer("fixed_point_group");
+        run_passes_in_order(step.passes, func, analyses, true);
+    }
+    if (!sequence.empty()) {
+        run_passes_in_order(sequence, func, analyses, false);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PASS_PIPELINE_H
+#define PASS_PIPELINE_H
+
+#include <stdbool.h>
+#include <llvm-c/Core.h>
+#include <string>
+#include <vector>
+
+// Pass pipelines described as text
+//
+//   cse,constant-folding,dce,fixed-point(constant-propagation,constant-folding),dce
+//
+// Passes run in the order given. The passes of a fixed-point group run in rounds until a round
+// changes nothing, and in every round after the first a pass only runs again if a change it
+// depends on was reported since its last run (constant folding only has new work when values
+// were replaced by constants, and so on). Consecutive passes that work on single blocks (cse and
+// constant-folding) share one walk over the blocks, each block going through all of them in turn.
+// Groups do not nest. Whitespace is ignored and in a pipeline file '#' starts a comment.
+
+// what a pass reports when it changed the function, and what a pass depends on
+#define PASS_CHANGE_CONSTANTS 1u    // values replaced by constants
+#define PASS_CHANGE_REPLACEMENTS 2u // values replaced by other instructions
+#define PASS_CHANGE_ERASURES 4u     // instructions erased
+#define PASS_CHANGE_ANY (PASS_CHANGE_CONSTANTS | PASS_CHANGE_REPLACEMENTS | PASS_CHANGE_ERASURES)
+
+struct function_analysis_manager;
+
+struct pipeline_pass {
+    const char *name;
+    bool (*run_on_block)(LLVMBasicBlockRef bb); // exactly one of the two is set
+    bool (*run_on_function)(LLVMValueRef func, struct function_analysis_manager &analyses);
+    unsigned changes_made;
+    unsigned depends_on;
+    bool reaches_own_fixed_point; // running it again right after itself never changes anything
+    unsigned preserved_analyses;  // what stays valid in the analysis manager when the pass changed the function
+};
+
+struct pipeline_step {
+    std::vector<const struct pipeline_pass *> passes; // a single pass, or the members of a group
+    bool is_fixed_point_group;
+};
+
+struct pass_pipeline {
+    std::vector<struct pipeline_step> steps;
+    std::string description; // canonical text, it is part of the function cache key
+};
+
+// opt levels, from nothing to the full default pipeline (DEFAULT_PASS_CONFIGURATION)
+#define PIPELINE_O0 ""
+#define PIPELINE_O1 "cse,constant-folding,dce"
+#define PIPELINE_O2 "cse,constant-folding,dce,global-constant-propagation"
+
+// level is "0", "1" or "2", NULL for any other level
+const char *pass_pipeline_preset(const char *level);
+
+// false with a message in error_message when the text names an unknown pass or is malformed
+bool parse_pass_pipeline(const char *text, struct pass_pipeline &pipeline, std::string &error_message);
+// for the presets and the other pipelines written in the code, which always parse
+struct pass_pipeline built_in_pass_pipeline(const char *text);
+bool read_pass_pipeline_file(const char *path, struct pass_pipeline &pipeline, std::string &error_message);
+
+// comma separated names of every pass a pipeline can use
+std::string pass_pipeline_available_passes();
+
+// the caller opens the function_arena_scope the passes allocate their hash tables from, the analyses
+// themselves are cached for the whole pipeline by the manager. When its compile budget runs out
+// the remaining passes are skipped.
+void run_pass_pipeline(const struct pass_pipeline &pipeline, struct function_analysis_manager &analyses);
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "pass_timing.h"
+
+bool pass_timing_enabled = false;
+
+struct pass_time {
+    const char *pass_name; // always a string literal, so pointers can be compared
+    long long total_ns;
+    unsigned long long calls;
+    unsigned long long hardware_counts[NUMBER_OF_HARDWARE_COUNTERS];
+};
+
+struct function_times {
+    std::string function_name;
+    std::vector<pass_time> passes;
+};
+
+// the function being optimized by this thread, merged into the global results at its end
+static thread_local function_times current_function;
+
+static std::mutex results_lock;
+static std::vector<function_times> function_results;
+
+// there are only a handful of passes, a linear scan is cheaper than hashing
+static void add_time(std::vector<pass_time> &passes, const char *pass_name, long long elapsed_ns, unsigned long long calls,
+                     const unsigned long long *hardware_counts) {
+    pass_time *found = NULL;
+    for (pass_time &entry : passes) {
+        if (entry.pass_name == pass_name || strcmp(entry.pass_name, pass_name) == 0) {
+            found = &entry;
+            break;
+        }
+    }
+    if (found == NULL) {
+        passes.push_back({pass_name, 0, 0, {0, 0, 0, 0, 0}});
+        found = &passes.back();
+    }
+    found->total_ns += elapsed_ns;
+    found->calls += calls;
+    if (hardware_counts != NULL) {
+        for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+            found->hardware_counts[counter] += hardware_counts[counter];
+        }
+    }
+}
+
+void pass_timing_record(const char *pass_name, long long elapsed_ns, const unsigned long long *hardware_counts) {
+    add_time(current_function.passes, pass_name, elapsed_ns, 1, hardware_counts);
+}
+
+void pass_timing_begin_function(const char *function_name) {
+    if (!pass_timing_enabled) {
+        return;
+    }
+    current_function.function_name = function_name;
+    current_function.passes.clear();
+}
+
+void pass_timing_end_function() {
+    if (!pass_timing_enabled) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(results_lock);
+    function_results.push_back(current_function);
+    current_function.passes.clear();
+}
+
+static std::vector<pass_time> sorted_module_totals() {
+    std::vector<pass_time> totals;
+    for (function_times &function : function_results) {
+        for (pass_time &entry : function.passes) {
+            add_time(totals, entry.pass_name, entry.total_ns, entry.calls, entry.hardware_counts);
+        }
+    }
+    std::sort(totals.begin(), totals.end(), [](const pass_time &a, const pass_time &b) { return a.total_ns > b.total_ns; });
+    return totals;
+}
+
+double pass_timing_total_ms(const char *pass_name) {
+    std::lock_guard<std::mutex> guard(results_lock);
+    long long total_ns = 0;
+    for (function_times &function : function_results) {
+        for (pass_time &entry : function.passes) {
+            if (strcmp(entry.pass_name, pass_name) == 0) {
+                total_ns += entry.total_ns;
+            }
+        }
+    }
+    return total_ns / 1e6;
+}
+
+void pass_timing_reset() {
+    std::lock_guard<std::mutex> guard(results_lock);
+    function_results.clear();
+}
+
+static void print_pass_table(FILE *output, std::vector<pass_time> passes) {
+    std::sort(passes.begin(), passes.end(), [](const pass_time &a, const pass_time &b) { return a.total_ns > b.total_ns; });
+    long long slowest_ns = passes.empty() ? 0 : passes[0].total_ns;
+    fprintf(output, "  %12s %8s %10s  %s\n", "time (ms)", "percent", "calls", "pass");
+    for (pass_time &entry : passes) {
+        // percentages are relative to the slowest entry, which is the whole pipeline (optimize_function)
+        double percent = slowest_ns == 0 ? 0 : 100.0 * entry.total_ns / slowest_ns;
+        fprintf(output, "  %12.3f %7.1f%% %10llu  %s\n", entry.total_ns / 1e6, percent, entry.calls, entry.pass_name);
+    }
+}
+
+void pass_timing_print_report(FILE *output) {
+    std::lock_guard<std::mutex> guard(results_lock);
+    fprintf(output, "===== Pass execution timing report (inclusive wall time) =====\n");
+    fprintf(output, "Module total over %zu functions:\n", function_results.size());
+    print_pass_table(output, sorted_module_totals());
+    for (function_times &function : function_results) {
+        fprintf(output, "Function %s:\n", function.function_name.c_str());
+        print_pass_table(output, function.passes);
+    }
+}
+
+static void print_json_string(FILE *output, const char *text) {
+    fputc('"', output);
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(output, "\\%c", *c);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(output, "\\u%04x", (unsigned char) *c);
+        } else {
+            fputc(*c, output);
+        }
+    }
+    fputc('"', output);
+}
+
+static void print_json_passes(FILE *output, std::vector<pass_time> passes) {
+    std::sort(passes.begin(), passes.end(), [](const pass_time &a, const pass_time &b) { return a.total_ns > b.total_ns; });
+    fprintf(output, "[");
+    for (size_t i = 0; i < passes.size(); i++) {
+        fprintf(output, "%s{\"pass\": ", i == 0 ? "" : ", ");
+        print_json_string(output, passes[i].pass_name);
+        fprintf(output, ", \"ms\": %.6f, \"calls\": %llu", passes[i].total_ns / 1e6, passes[i].calls);
+        if (hardware_counters_enabled) {
+            for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+                if (hardware_counter_is_available(counter)) {
+                    fprintf(output, ", \"%s\": %llu", hardware_counter_names[counter], passes[i].hardware_counts[counter]);
+                }
+            }
+        }
+        fprintf(output, "}");
+    }
+    fprintf(output, "]");
+}
+
+void pass_timing_print_json(FILE *output) {
+    std::lock_guard<std::mutex> guard(results_lock);
+    fprintf(output, "{\"module\": ");
+    print_json_passes(output, sorted_module_totals());
+    fprintf(output, ",\n \"functions\": [");
+    for (size_t i = 0; i < function_results.size(); i++) {
+        fprintf(output, "%s\n  {\"function\": ", i == 0 ? "" : ",");
+        print_json_string(output, function_results[i].function_name.c_str());
+        fprintf(output, ", \"passes\": ");
+        print_json_passes(output, function_results[i].passes);
+        fprintf(output, "}");
+    }
+    fprintf(output, "]}\n");
+}
+
+static void print_hardware_table(FILE *output, std::vector<pass_time> passes) {
+    std::sort(passes.begin(), passes.end(), [](const pass_time &a, const pass_time &b) {
+        return a.hardware_counts[HARDWARE_CYCLES] > b.hardware_counts[HARDWARE_CYCLES];
+    });
+    fprintf(output, "  %14s %14s %6s %12s %12s %12s  %s\n", "cycles", "instructions", "IPC", "L1d misses", "LLC misses", "br misses", "pass");
+    for (pass_time &entry : passes) {
+        fprintf(output, " ");
+        for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+            int width = counter <= HARDWARE_INSTRUCTIONS ? 14 : 12;
+            if (hardware_counter_is_available(counter)) {
+                fprintf(output, " %*llu", width, entry.hardware_counts[counter]);
+            } else {
+                fprintf(output, " %*s", width, "n/a");
+            }
+            if (counter == HARDWARE_INSTRUCTIONS) {
+                unsigned long long cycles = entry.hardware_counts[HARDWARE_CYCLES];
+                bool has_ipc = hardware_counter_is_available(HARDWARE_CYCLES) && hardware_counter_is_available(HARDWARE_INSTRUCTIONS) && cycles != 0;
+                if (has_ipc) {
+                    fprintf(output, " %6.2f", (double) entry.hardware_counts[HARDWARE_INSTRUCTIONS] / cycles);
+                } else {
+                    fprintf(output, " %6s", "n/a");
+                }
+            }
+        }
+        fprintf(output, "  %s\n", entry.pass_name);
+    }
+}
+
+void pass_timing_print_hardware_report(FILE *output) {
+    std::lock_guard<std::mutex> guard(results_lock);
+    fprintf(output, "===== Hardware counters per pass (inclusive, user space) =====\n");
+    fprintf(output, "Module total over %zu functions:\n", function_results.size());
+    print_hardware_table(output, sorted_module_totals());
+    for (function_times &function : function_results) {
+        fprintf(output, "Function %s:\n", function.function_name.c_str());
+        print_hardware_table(output, function.passes);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef PASS_TIMING_H
+#define PASS_TIMING_H
+
+#include <stdio.h>
+#include <time.h>
+#include "hardware_counters.h"
+#include "allocation_profiling.h"
+
+// -time-passes style timing of every pass and analysis
+//
+// Each pass and analysis opens a scoped_pass_timer named after the function implementing it. Times
+// are inclusive (in_and_out_sets_map also counts the gen and kill sets it computes), collected per
+// optimized function and summed for the module. When timing is off a timer costs one branch.
+// With hardware_counters_enabled the timers also read the hardware counters on entry and exit, and
+// in the allocation profiling build they tag the allocations made while the pass runs.
+
+extern bool pass_timing_enabled;
+
+static inline long long pass_timing_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+// hardware_counts holds the counter increments of the pass, NULL when the counters are off
+void pass_timing_record(const char *pass_name, long long elapsed_ns, const unsigned long long *hardware_counts);
+
+struct scoped_pass_timer {
+    const char *pass_name;
+    long long start_ns;
+    unsigned long long start_counts[NUMBER_OF_HARDWARE_COUNTERS];
+#ifdef OPTIMIZER_ALLOCATION_PROFILING
+    scoped_allocation_tag allocation_tag;
+#endif
+
+    explicit scoped_pass_timer(const char *name)
+        : pass_name(name), start_ns(0)
+#ifdef OPTIMIZER_ALLOCATION_PROFILING
+        , allocation_tag(name)
+#endif
+    {
+        if (pass_timing_enabled) {
+            if (hardware_counters_enabled) {
+                hardware_counters_read(start_counts);
+            }
+            start_ns = pass_timing_now_ns();
+        }
+    }
+    ~scoped_pass_timer() {
+        if (start_ns != 0) {
+            long long elapsed_ns = pass_timing_now_ns() - start_ns;
+            if (hardware_counters_enabled) {
+                unsigned long long counts[NUMBER_OF_HARDWARE_COUNTERS];
+                hardware_counters_read(counts);
+                for (int counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; counter++) {
+                    counts[counter] -= start_counts[counter];
+                }
+                pass_timing_record(pass_name, elapsed_ns, counts);
+            } else {
+                pass_timing_record(pass_name, elapsed_ns, NULL);
+            }
+        }
+    }
+};
+
+// the timers recorded between these two calls are attributed to function_name
+void pass_timing_begin_function(const char *function_name);
+void pass_timing_end_function();
+
+// total time recorded so far for one pass over every function, and a way to start over
+// (used by the benchmarks that time the same passes at several input sizes)
+double pass_timing_total_ms(const char *pass_name);
+void pass_timing_reset();
+
+// sorted text report, slowest pass first, for the module and then for each function
+void pass_timing_print_report(FILE *output);
+void pass_timing_print_json(FILE *output);
+
+// cycles, instructions per cycle and misses of every pass, for the module and then for each function
+void pass_timing_print_hardware_report(FILE *output);
+
+#endif
@@ -0,0 +1,143 @@
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "scc_scheduler.h"
+#include "optimizer_statistics.h"
+
+OPTIMIZER_STATISTIC(sccs_scheduled, "scc_scheduler", "Number of call graph components run bottom-up");
+OPTIMIZER_STATISTIC(tasks_run_by_workers, "scc_scheduler", "Number of tasks run on a worker thread");
+OPTIMIZER_STATISTIC(most_components_in_flight, "scc_scheduler", "Most components started and not yet finished at once");
+
+struct task_pool {
+    std::mutex lock;
+    std::condition_variable has_task;
+    std::condition_variable has_completion;
+    std::deque<std::pair<unsigned, scc_task>> tasks; // each with its component
+    std::deque<unsigned> completed; // the component of every task that has run
+    bool closed = false;
+};
+
+static void run_worker(struct task_pool *pool) {
+    while (true) {
+        std::pair<unsigned, scc_task> task;
+        {
+            std::unique_lock<std::mutex> guard(pool->lock);
+            pool->has_task.wait(guard, [pool] { return pool->closed || !pool->tasks.empty(); });
+            if (pool->tasks.empty()) { // closed and drained
+                return;
+            }
+            task = std::move(pool->tasks.front());
+            pool->tasks.pop_front();
+        }
+        task.second();
+        tasks_run_by_workers++;
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->completed.push_back(task.first);
+        }
+        pool->has_completion.notify_one();
+    }
+}
+
+void run_scc_schedule(const struct call_graph &graph, unsigned number_of_threads, const struct scc_schedule &schedule) {
+    size_t number_of_sccs = graph.sccs.size();
+    // the components each one calls into that have not finished, and the ones calling into it
+    std::vector<unsigned> callees_left(number_of_sccs, 0);
+    std::vector<std::vector<unsigned>> callers(number_of_sccs);
+    std::vector<unsigned> last_caller(number_of_sccs, std::numeric_limits<unsigned>::max());
+    for (unsigned scc = 0; scc < number_of_sccs; scc++) {
+        for (unsigned function_index : graph.sccs[scc]) {
+            for (unsigned callee : graph.callees[function_index]) {
+                unsigned callee_scc = graph.scc_of[callee];
+                if (callee_scc != scc && last_caller[callee_scc] != scc) {
+                    last_caller[callee_scc] = scc;
+                    callees_left[scc]++;
+                    callers[callee_scc].push_back(scc);
+                }
+            }
+        }
+    }
+    // the lowest index first, so that without workers the order is the one of graph.sccs
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> ready;
+    for (unsigned scc = 0; scc < number_of_sccs; scc++) {
+        if (callees_left[scc] == 0) {
+            ready.push(scc);
+        }
+    }
+
+    struct task_pool pool;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; number_of_threads > 1 && i < number_of_threads; i++) {
+        workers.emplace_back(run_worker, &pool);
+    }
+    std::vector<unsigned> tasks_left(number_of_sccs, 0);
+    size_t finished = 0;
+    unsigned long long in_flight = 0;
+    auto finish = [&](unsigned scc) {
+        schedule.finish(scc);
+        finished++;
+        in_flight--;
+        sccs_scheduled++;
+        for (unsigned caller : callers[scc]) {
+            if (--callees_left[caller] == 0) {
+                ready.push(caller);
+            }
+        }
+    };
+    while (finished < number_of_sccs) {
+        while (!ready.empty()) {
+            unsigned scc = ready.top();
+            ready.pop();
+            std::vector<scc_task> tasks;
+            schedule.start(scc, tasks);
+            most_components_in_flight.record_maximum(++in_flight);
+            if (workers.empty()) {
+                for (scc_task &task : tasks) {
+                    task();
+                }
+                tasks.clear();
+            }
+            if (tasks.empty()) {
+                finish(scc);
+                continue;
+            }
+            tasks_left[scc] = tasks.size();
+            {
+                std::lock_guard<std::mutex> guard(pool.lock);
+                for (scc_task &task : tasks) {
+                    pool.tasks.push_back(std::make_pair(scc, std::move(task)));
+                }
+            }
+            pool.has_task.notify_all();
+        }
+        if (finished == number_of_sccs) {
+            break;
+        }
+        // every component left waits on one in flight, nothing can start before a task is done
+        std::deque<unsigned> completed;
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            pool.has_completion.wait(guard, [&pool] { return !pool.completed.empty(); });
+            completed.swap(pool.completed);
+        }
+        for (unsigned scc : completed) {
+            if (--tasks_left[scc] == 0) {
+                finish(scc);
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.closed = true;
+    }
+    pool.has_task.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef SCC_SCHEDULER_H
+#define SCC_SCHEDULER_H
+
+#include <functional>
+#include <vector>
+#include "call_graph.h"
+
+// Bottom-up scheduling of the strongly connected components of a call graph on a thread pool
+//
+// A component starts once every component it calls into has finished, so whatever is derived
+// from the callees (their optimized bodies for the inliner, their summaries) is ready when their
+// callers run. Components that do not depend on each other are in flight at the same time, and a
+// component starts as soon as its own callees are done instead of waiting for a whole level.
+//
+// Starting and finishing a component happen on the calling thread, the only one that may touch
+// the module. start gives the tasks of the component, which run on the worker threads and must
+// not touch the module. finish runs once all of them have. With one thread there are no workers,
+// the tasks run right after start and the components go in the order of graph.sccs.
+
+typedef std::function<void()> scc_task;
+
+struct scc_schedule {
+    std::function<void(unsigned scc, std::vector<scc_task> &tasks)> start;
+    std::function<void(unsigned scc)> finish;
+};
+
+void run_scc_schedule(const struct call_graph &graph, unsigned number_of_threads, const struct scc_schedule &schedule);
+
+#endif